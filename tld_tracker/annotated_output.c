@@ -0,0 +1,136 @@
+#include "annotated_output.h"
+#include <stdlib.h>
+#include <string.h>
+
+static void annotated_frame_render(AnnotatedFrame* af) {
+    draw_candidates(&af->frame, af->proposals, (size_t)af->proposals_count);
+    draw_candidates(&af->frame, af->clusters, (size_t)af->clusters_count);
+    draw_candidate(&af->frame, af->tracker_proposal);
+    draw_candidate(&af->frame, af->prediction);
+}
+
+static int annotated_frame_write(AnnotatedOutput* out, const AnnotatedFrame* af) {
+    const Image* img = &af->frame;
+    FILE* file = out->y4m;
+    if (file) {
+        if (!out->header_written) {
+            int num = out->fps > 0.0 ? (int)(out->fps * 1000.0 + 0.5) : 30000;
+            fprintf(file, "YUV4MPEG2 W%d H%d F%d:1000 Ip A1:1 Cmono\n", img->width, img->height, num);
+            out->header_written = 1;
+        }
+        fputs("FRAME\n", file);
+    } else {
+        char path[4096];
+        snprintf(path, sizeof(path), out->pgm_pattern, (int)af->frame_id);
+        file = fopen(path, "wb");
+        if (!file)
+            return 0;
+        fprintf(file, "P5\n%d %d\n255\n", img->width, img->height);
+    }
+    for (int y = 0; y < img->height; ++y)
+        fwrite(image_row(img, y), 1, (size_t)img->width, file);
+    if (!out->y4m)
+        fclose(file);
+    return 1;
+}
+
+static void* annotated_output_writer(void* arg) {
+    AnnotatedOutput* out = (AnnotatedOutput*)arg;
+    AnnotatedFrame* af;
+    while ((af = (AnnotatedFrame*)spsc_queue_pop(&out->pending)) != NULL) {
+        if (af->frame.data) {
+            annotated_frame_render(af);
+            if (annotated_frame_write(out, af))
+                atomic_fetch_add_explicit(&out->written, 1, memory_order_relaxed);
+        }
+        spsc_queue_push(&out->free_slots, af);
+    }
+    if (out->y4m)
+        fflush(out->y4m);
+    return NULL;
+}
+
+static void annotated_output_release(AnnotatedOutput* out) {
+    if (out->y4m)
+        fclose(out->y4m);
+    for (int i = 0; i < ANNOTATED_OUTPUT_SLOTS; ++i)
+        image_free(&out->slots[i].frame);
+    free(out->pgm_pattern);
+    spsc_queue_free(&out->free_slots);
+    spsc_queue_free(&out->pending);
+    free(out);
+}
+
+AnnotatedOutput* annotated_output_open(const char* path, double fps) {
+    AnnotatedOutput* out = (AnnotatedOutput*)calloc(1, sizeof(AnnotatedOutput));
+    if (!out)
+        return NULL;
+    size_t len = strlen(path);
+    if (len >= 4 && strcmp(path + len - 4, ".y4m") == 0)
+        out->y4m = fopen(path, "wb");
+    else if (strchr(path, '%'))
+        out->pgm_pattern = strdup(path);
+    out->fps = fps;
+    atomic_init(&out->dropped, 0);
+    atomic_init(&out->written, 0);
+    if ((!out->y4m && !out->pgm_pattern) ||
+        !spsc_queue_init(&out->free_slots, ANNOTATED_OUTPUT_SLOTS) ||
+        !spsc_queue_init(&out->pending, ANNOTATED_OUTPUT_SLOTS + 1)) {
+        annotated_output_release(out);
+        return NULL;
+    }
+    for (int i = 0; i < ANNOTATED_OUTPUT_SLOTS; ++i)
+        spsc_queue_try_push(&out->free_slots, &out->slots[i]);
+    if (pthread_create(&out->writer, NULL, annotated_output_writer, out) != 0) {
+        annotated_output_release(out);
+        return NULL;
+    }
+    return out;
+}
+
+void annotated_output_close(AnnotatedOutput* out) {
+    if (!out)
+        return;
+    spsc_queue_push(&out->pending, NULL);
+    pthread_join(out->writer, NULL);
+    fprintf(stderr, "Annotated output: %llu frames written, %llu dropped\n",
+            (unsigned long long)atomic_load(&out->written), (unsigned long long)atomic_load(&out->dropped));
+    annotated_output_release(out);
+}
+
+static int copy_boxes(Candidate* dst, CandidateArray src) {
+    int count = src.count < ANNOTATED_OUTPUT_MAX_BOXES ? src.count : ANNOTATED_OUTPUT_MAX_BOXES;
+    if (count > 0)
+        memcpy(dst, src.data, sizeof(Candidate) * (size_t)count);
+    return count > 0 ? count : 0;
+}
+
+int annotated_output_submit(AnnotatedOutput* out, const Image* frame, uint64_t frame_id,
+                            Candidate prediction, const TldTracker* tracker) {
+    void* slot;
+    if (!spsc_queue_try_pop(&out->free_slots, &slot)) {
+        atomic_fetch_add_explicit(&out->dropped, 1, memory_order_relaxed);
+        return 0;
+    }
+    AnnotatedFrame* af = (AnnotatedFrame*)slot;
+    Image* img = &af->frame;
+    if (!img->data || img->width != frame->width || img->height != frame->height) {
+        image_free(img);
+        *img = image_create(frame->width, frame->height);
+        if (!img->data) {
+            // Handed over empty: only the writer thread returns slots
+            spsc_queue_try_push(&out->pending, af);
+            atomic_fetch_add_explicit(&out->dropped, 1, memory_order_relaxed);
+            return 0;
+        }
+    }
+    for (int y = 0; y < frame->height; ++y)
+        memcpy(image_row(img, y), image_row(frame, y), (size_t)frame->width);
+    af->frame_id = frame_id;
+    af->prediction = prediction;
+    af->tracker_proposal = tld_tracker_get_tracker_proposal(tracker);
+    af->proposals_count = copy_boxes(af->proposals, tld_tracker_get_detector_proposals(tracker));
+    af->clusters_count = copy_boxes(af->clusters, tld_tracker_get_clusters(tracker));
+    spsc_queue_try_push(&out->pending, af);
+    return 1;
+}
@@ -0,0 +1,53 @@
+#ifndef ANNOTATED_OUTPUT_H
+#define ANNOTATED_OUTPUT_H
+
+#include "tld_tracker.h"
+#include "spsc_queue.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Frames being copied, drawn or written at a time
+#define ANNOTATED_OUTPUT_SLOTS 3
+#define ANNOTATED_OUTPUT_MAX_BOXES 256
+
+typedef struct {
+    Image frame;                 // private copy, drawn on by the writer thread
+    uint64_t frame_id;
+    Candidate prediction;
+    Candidate tracker_proposal;
+    // Detector boxes of this very frame; none when it skipped detection (fast path)
+    Candidate proposals[ANNOTATED_OUTPUT_MAX_BOXES];
+    int proposals_count;
+    Candidate clusters[ANNOTATED_OUTPUT_MAX_BOXES];
+    int clusters_count;
+} AnnotatedFrame;
+
+// Annotated frames written as a Y4M (mono) stream or a numbered PGM sequence.
+// The tracking thread only copies the frame and its boxes into a free slot;
+// drawing and writing happen on a writer thread. If no slot is free the
+// frame is dropped, so a slow disk never slows tracking down.
+typedef struct {
+    FILE* y4m;                   // NULL when writing PGMs
+    char* pgm_pattern;
+    double fps;
+    int header_written;
+    AnnotatedFrame slots[ANNOTATED_OUTPUT_SLOTS];
+    SpscQueue free_slots;        // writer thread -> tracking thread
+    SpscQueue pending;           // tracking thread -> writer thread, NULL stops it
+    atomic_uint_least64_t dropped;
+    atomic_uint_least64_t written;
+    pthread_t writer;
+} AnnotatedOutput;
+
+// "*.y4m" for a stream, a printf pattern with one integer (the frame id) for
+// PGMs. NULL if the output cannot be created.
+AnnotatedOutput* annotated_output_open(const char* path, double fps);
+// Writes the frames still queued and closes the output
+void annotated_output_close(AnnotatedOutput* out);
+// Returns 0 if the frame was dropped
+int annotated_output_submit(AnnotatedOutput* out, const Image* frame, uint64_t frame_id,
+                            Candidate prediction, const TldTracker* tracker);
+
+#endif
@@ -0,0 +1,449 @@
+#include "frame_source.h"
+#include "shm_frame_ring.h"
+#include "synthetic_sequence.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct {
+    const uint8_t* data;
+    size_t size;
+} FileMapping;
+
+static int file_map(const char* path, FileMapping* map) {
+    map->data = NULL;
+    map->size = 0;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return 0;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return 0;
+    }
+    void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return 0;
+    map->data = (const uint8_t*)data;
+    map->size = (size_t)st.st_size;
+    return 1;
+}
+
+static void file_unmap(FileMapping* map) {
+    if (map->data)
+        munmap((void*)map->data, map->size);
+    map->data = NULL;
+    map->size = 0;
+}
+
+// Asks the kernel to start reading [offset, offset + len) in the background
+static void file_prefetch(const FileMapping* map, size_t offset, size_t len) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    if (offset >= map->size)
+        return;
+    if (len > map->size - offset)
+        len = map->size - offset;
+    size_t start = offset & ~(page - 1);
+    madvise((void*)(map->data + start), len + (offset - start), MADV_WILLNEED);
+}
+
+static Image gray_view(const uint8_t* data, int width, int height) {
+    Image img;
+    img.width = width;
+    img.height = height;
+    img.stride = width;
+    img.border = 0;
+    img.data = (uint8_t*)data;
+    return img;
+}
+
+// Frames fetched ahead of the one returned by the mapped stream readers
+#define STREAM_PREFETCH_FRAMES 4
+
+// Raw GRAY8
+
+typedef struct {
+    FrameSource base;
+    FileMapping map;
+    size_t frame_size;
+    size_t index;
+} RawSource;
+
+static int raw_next(FrameSource* src, Image* out) {
+    RawSource* raw = (RawSource*)src;
+    if (raw->index >= src->frame_count)
+        return 0;
+    size_t offset = raw->index * raw->frame_size;
+    file_prefetch(&raw->map, offset + STREAM_PREFETCH_FRAMES * raw->frame_size, raw->frame_size);
+    *out = gray_view(raw->map.data + offset, src->width, src->height);
+    raw->index++;
+    return 1;
+}
+
+static void raw_close(FrameSource* src) {
+    RawSource* raw = (RawSource*)src;
+    file_unmap(&raw->map);
+    free(raw);
+}
+
+FrameSource* frame_source_open_raw(const char* path, int width, int height) {
+    if (width <= 0 || height <= 0)
+        return NULL;
+    RawSource* raw = (RawSource*)calloc(1, sizeof(RawSource));
+    if (!raw || !file_map(path, &raw->map)) {
+        free(raw);
+        return NULL;
+    }
+    raw->frame_size = (size_t)width * height;
+    raw->base.next = raw_next;
+    raw->base.close = raw_close;
+    raw->base.width = width;
+    raw->base.height = height;
+    raw->base.frame_count = raw->map.size / raw->frame_size;
+    madvise((void*)raw->map.data, raw->map.size, MADV_SEQUENTIAL);
+    file_prefetch(&raw->map, 0, STREAM_PREFETCH_FRAMES * raw->frame_size);
+    return &raw->base;
+}
+
+// YUV4MPEG2: "YUV4MPEG2 W.. H.. F..:.. C...\n" then "FRAME[ params]\n" and the
+// planes of each frame
+
+typedef struct {
+    FrameSource base;
+    FileMapping map;
+    size_t frame_size;   // all planes
+    size_t offset;       // of the next FRAME header
+} Y4mSource;
+
+static const uint8_t* find_newline(const FileMapping* map, size_t offset) {
+    if (offset >= map->size)
+        return NULL;
+    return (const uint8_t*)memchr(map->data + offset, '\n', map->size - offset);
+}
+
+static int y4m_next(FrameSource* src, Image* out) {
+    Y4mSource* y4m = (Y4mSource*)src;
+    const uint8_t* eol = find_newline(&y4m->map, y4m->offset);
+    if (!eol)
+        return 0;
+    if (eol - (y4m->map.data + y4m->offset) < 5 || memcmp(y4m->map.data + y4m->offset, "FRAME", 5) != 0)
+        return -1;
+    size_t data_offset = (size_t)(eol - y4m->map.data) + 1;
+    if (y4m->map.size - data_offset < y4m->frame_size)
+        return 0;   // truncated last frame
+    y4m->offset = data_offset + y4m->frame_size;
+    file_prefetch(&y4m->map, data_offset + STREAM_PREFETCH_FRAMES * (y4m->frame_size + 6), y4m->frame_size);
+    *out = gray_view(y4m->map.data + data_offset, src->width, src->height);
+    return 1;
+}
+
+static void y4m_close(FrameSource* src) {
+    Y4mSource* y4m = (Y4mSource*)src;
+    file_unmap(&y4m->map);
+    free(y4m);
+}
+
+// Bytes of the planes following the luma one, -1 if the colorspace is not supported
+static long y4m_chroma_size(const char* colorspace, int width, int height) {
+    long cw = (width + 1) / 2, ch = (height + 1) / 2;
+    // C420p10, C444p12, mono16, ...
+    if (strncmp(colorspace, "mono16", 6) == 0 ||
+        (colorspace[0] && colorspace[1] && colorspace[2] && colorspace[3] == 'p' &&
+         colorspace[4] >= '0' && colorspace[4] <= '9'))
+        return -1;
+    if (strncmp(colorspace, "mono", 4) == 0)
+        return 0;
+    if (strncmp(colorspace, "420", 3) == 0)
+        return 2 * cw * ch;
+    if (strncmp(colorspace, "422", 3) == 0)
+        return 2 * cw * height;
+    if (strncmp(colorspace, "444alpha", 8) == 0)
+        return 3L * width * height;
+    if (strncmp(colorspace, "444", 3) == 0)
+        return 2L * width * height;
+    return -1;   // 411 and high bit depths
+}
+
+FrameSource* frame_source_open_y4m(const char* path) {
+    Y4mSource* y4m = (Y4mSource*)calloc(1, sizeof(Y4mSource));
+    if (!y4m || !file_map(path, &y4m->map)) {
+        free(y4m);
+        return NULL;
+    }
+    const uint8_t* eol = find_newline(&y4m->map, 0);
+    if (!eol || y4m->map.size < 10 || memcmp(y4m->map.data, "YUV4MPEG2 ", 10) != 0) {
+        y4m_close(&y4m->base);
+        return NULL;
+    }
+    char header[256];
+    size_t len = (size_t)(eol - y4m->map.data);
+    if (len >= sizeof(header))
+        len = sizeof(header) - 1;
+    memcpy(header, y4m->map.data, len);
+    header[len] = '\0';
+
+    int width = 0, height = 0;
+    const char* colorspace = "420";
+    int fps_num = 0, fps_den = 0;
+    for (char* tok = strtok(header + 10, " "); tok; tok = strtok(NULL, " ")) {
+        if (tok[0] == 'W')
+            width = atoi(tok + 1);
+        else if (tok[0] == 'H')
+            height = atoi(tok + 1);
+        else if (tok[0] == 'F')
+            sscanf(tok + 1, "%d:%d", &fps_num, &fps_den);
+        else if (tok[0] == 'C')
+            colorspace = tok + 1;
+    }
+    long chroma = width > 0 && height > 0 ? y4m_chroma_size(colorspace, width, height) : -1;
+    if (chroma < 0) {
+        fprintf(stderr, "Unsupported Y4M stream: %s\n", path);
+        y4m_close(&y4m->base);
+        return NULL;
+    }
+    y4m->frame_size = (size_t)width * height + (size_t)chroma;
+    y4m->offset = len + 1;
+    y4m->base.next = y4m_next;
+    y4m->base.close = y4m_close;
+    y4m->base.width = width;
+    y4m->base.height = height;
+    y4m->base.fps = fps_den > 0 ? (double)fps_num / fps_den : 0.0;
+    y4m->base.frame_count = (y4m->map.size - y4m->offset) / (y4m->frame_size + 6);
+    madvise((void*)y4m->map.data, y4m->map.size, MADV_SEQUENTIAL);
+    file_prefetch(&y4m->map, 0, STREAM_PREFETCH_FRAMES * (y4m->frame_size + 6));
+    return &y4m->base;
+}
+
+// Numbered PGM files. Each file is mapped on its own; the next
+// PGM_SEQUENCE_READ_AHEAD ones are mapped and prefetched ahead of use, and the
+// current and previous ones are kept for the frame lifetime next promises.
+
+#define PGM_WINDOW (PGM_SEQUENCE_READ_AHEAD + 2)
+
+typedef struct {
+    FileMapping map;
+    int index;           // file number, -1 if the slot is empty
+} PgmFile;
+
+typedef struct {
+    FrameSource base;
+    char* pattern;
+    int next_index;      // of the next frame to return
+    int last_index;      // one past the last existing file, once found
+    PgmFile files[PGM_WINDOW];
+} PgmSequenceSource;
+
+// Pixel data of a binary 8-bit PGM, NULL if the header is not one
+static const uint8_t* pgm_parse(const FileMapping* map, int* width, int* height) {
+    const uint8_t* p = map->data;
+    const uint8_t* end = map->data + map->size;
+    if (map->size < 2 || p[0] != 'P' || p[1] != '5')
+        return NULL;
+    p += 2;
+    int values[3];
+    for (int i = 0; i < 3; ++i) {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n' || *p == '#')) {
+            if (*p == '#')
+                while (p < end && *p != '\n')
+                    ++p;
+            else
+                ++p;
+        }
+        if (p >= end || *p < '0' || *p > '9')
+            return NULL;
+        int v = 0;
+        while (p < end && *p >= '0' && *p <= '9' && v < 1000000)
+            v = v * 10 + (*p++ - '0');
+        values[i] = v;
+    }
+    // A single whitespace character separates the header from the pixels
+    if (p >= end || values[2] <= 0 || values[2] > 255)
+        return NULL;
+    ++p;
+    if ((size_t)(end - p) < (size_t)values[0] * values[1])
+        return NULL;
+    *width = values[0];
+    *height = values[1];
+    return p;
+}
+
+static PgmFile* pgm_sequence_slot(PgmSequenceSource* seq, int index) {
+    return &seq->files[index % PGM_WINDOW];
+}
+
+// Maps file index into its slot unless the sequence already ended before it
+static int pgm_sequence_map(PgmSequenceSource* seq, int index) {
+    PgmFile* file = pgm_sequence_slot(seq, index);
+    if (file->index == index)
+        return file->map.data != NULL;
+    if (seq->last_index >= 0 && index >= seq->last_index)
+        return 0;
+    file_unmap(&file->map);
+    file->index = index;
+    char path[4096];
+    snprintf(path, sizeof(path), seq->pattern, index);
+    if (!file_map(path, &file->map)) {
+        seq->last_index = index;
+        return 0;
+    }
+    file_prefetch(&file->map, 0, file->map.size);
+    return 1;
+}
+
+static int pgm_sequence_next(FrameSource* src, Image* out) {
+    PgmSequenceSource* seq = (PgmSequenceSource*)src;
+    int index = seq->next_index;
+    if (!pgm_sequence_map(seq, index))
+        return 0;
+    for (int k = 1; k <= PGM_SEQUENCE_READ_AHEAD; ++k)
+        if (!pgm_sequence_map(seq, index + k))
+            break;
+    PgmFile* file = pgm_sequence_slot(seq, index);
+    int width, height;
+    const uint8_t* pixels = pgm_parse(&file->map, &width, &height);
+    if (!pixels || width != src->width || height != src->height) {
+        fprintf(stderr, "Bad or differently sized PGM in the sequence, frame %d\n", index);
+        return -1;
+    }
+    *out = gray_view(pixels, width, height);
+    seq->next_index++;
+    return 1;
+}
+
+static void pgm_sequence_close(FrameSource* src) {
+    PgmSequenceSource* seq = (PgmSequenceSource*)src;
+    for (int i = 0; i < PGM_WINDOW; ++i)
+        file_unmap(&seq->files[i].map);
+    free(seq->pattern);
+    free(seq);
+}
+
+FrameSource* frame_source_open_pgm_sequence(const char* pattern, int first_index) {
+    PgmSequenceSource* seq = (PgmSequenceSource*)calloc(1, sizeof(PgmSequenceSource));
+    if (!seq)
+        return NULL;
+    seq->pattern = strdup(pattern);
+    seq->next_index = first_index;
+    seq->last_index = -1;
+    for (int i = 0; i < PGM_WINDOW; ++i)
+        seq->files[i].index = -1;
+    seq->base.next = pgm_sequence_next;
+    seq->base.close = pgm_sequence_close;
+    const uint8_t* pixels = NULL;
+    if (seq->pattern && pgm_sequence_map(seq, first_index))
+        pixels = pgm_parse(&pgm_sequence_slot(seq, first_index)->map, &seq->base.width, &seq->base.height);
+    if (!pixels) {
+        pgm_sequence_close(&seq->base);
+        return NULL;
+    }
+    return &seq->base;
+}
+
+// Shared-memory ring. The reader holds the frame it returned last (the
+// tracker's previous one once the next frame is returned) and everything
+// after it.
+
+#define SHM_SOURCE_POLL_US 200
+
+typedef struct {
+    FrameSource base;
+    ShmFrameRing ring;
+    uint64_t next_frame;
+    uint64_t last_frame;
+    int has_last;
+    int skip_to_latest;
+    int timeout_ms;
+} ShmSource;
+
+static int shm_next(FrameSource* src, Image* out) {
+    ShmSource* shm = (ShmSource*)src;
+    ShmFrameRingHeader* h = shm->ring.header;
+    int64_t waited_us = 0;
+    while (1) {
+        uint64_t published = atomic_load_explicit(&h->write_seq, memory_order_acquire);
+        if (shm->next_frame < published) {
+            uint64_t frame = shm->skip_to_latest ? published - 1 : shm->next_frame;
+            shm->next_frame = frame + 1;
+            // Only the first frame can be overwritten before the hold set by
+            // shm_frame_ring_reader_start takes effect; later ones are >= the
+            // hold from the moment they are published
+            if (!shm->has_last && !shm_frame_ring_frame_ready(&shm->ring, frame, NULL))
+                continue;
+            // The frame before this one stays held for the tracker
+            if (shm->has_last)
+                shm_frame_ring_hold(&shm->ring, shm->last_frame);
+            shm->last_frame = frame;
+            shm->has_last = 1;
+            Image img;
+            img.width = src->width;
+            img.height = src->height;
+            img.stride = (int)h->stride;
+            img.border = 0;
+            img.data = shm_frame_ring_slot_data(&shm->ring, frame);
+            *out = img;
+            return 1;
+        }
+        if (atomic_load_explicit(&h->closed, memory_order_acquire) &&
+            shm->next_frame >= atomic_load_explicit(&h->write_seq, memory_order_acquire))
+            return 0;
+        if (shm->timeout_ms >= 0 && waited_us >= (int64_t)shm->timeout_ms * 1000) {
+            fprintf(stderr, "No frame from the shared-memory writer for %d ms\n", shm->timeout_ms);
+            return -1;
+        }
+        struct timespec ts = { 0, SHM_SOURCE_POLL_US * 1000 };
+        nanosleep(&ts, NULL);
+        waited_us += SHM_SOURCE_POLL_US;
+    }
+}
+
+static void shm_close(FrameSource* src) {
+    ShmSource* shm = (ShmSource*)src;
+    shm_frame_ring_close(&shm->ring);
+    free(shm);
+}
+
+FrameSource* frame_source_open_shm(const char* name, int skip_to_latest, int timeout_ms) {
+    ShmSource* shm = (ShmSource*)calloc(1, sizeof(ShmSource));
+    if (!shm || !shm_frame_ring_attach(&shm->ring, name)) {
+        free(shm);
+        return NULL;
+    }
+    shm->base.next = shm_next;
+    shm->base.close = shm_close;
+    shm->base.width = (int)shm->ring.header->width;
+    shm->base.height = (int)shm->ring.header->height;
+    shm->skip_to_latest = skip_to_latest;
+    shm->timeout_ms = timeout_ms;
+    shm->next_frame = shm_frame_ring_reader_start(&shm->ring);
+    return &shm->base;
+}
+
+static int has_suffix(const char* s, const char* suffix) {
+    size_t n = strlen(s), m = strlen(suffix);
+    return n >= m && strcmp(s + n - m, suffix) == 0;
+}
+
+FrameSource* frame_source_open(const char* path, int raw_width, int raw_height) {
+    if (strncmp(path, "shm:", 4) == 0)
+        return frame_source_open_shm(path + 4, 0, 5000);
+    if (strncmp(path, "synth:", 6) == 0) {
+        SyntheticSettings settings;
+        synthetic_settings_default(&settings);
+        return synthetic_settings_parse(&settings, path + 6) ? frame_source_open_synthetic(&settings) : NULL;
+    }
+    if (has_suffix(path, ".y4m"))
+        return frame_source_open_y4m(path);
+    if (strchr(path, '%')) {
+        FrameSource* src = frame_source_open_pgm_sequence(path, 0);
+        return src ? src : frame_source_open_pgm_sequence(path, 1);
+    }
+    if (raw_width > 0 && raw_height > 0)
+        return frame_source_open_raw(path, raw_width, raw_height);
+    return NULL;
+}
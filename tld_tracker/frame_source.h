@@ -0,0 +1,51 @@
+#ifndef FRAME_SOURCE_H
+#define FRAME_SOURCE_H
+
+#include "tld_utils.h"
+#include <stddef.h>
+
+// Source of gray frames. next fills out with a view of the source's memory (no
+// copy); a frame stays valid and unchanged until next has been called twice
+// more, long enough for the tracker's previous frame, or until close.
+typedef struct FrameSource FrameSource;
+struct FrameSource {
+    int (*next)(FrameSource* src, Image* out);   // 1 frame, 0 end of stream, -1 error
+    void (*close)(FrameSource* src);             // also frees src
+    int width, height;
+    double fps;                                  // 0 if unknown
+    size_t frame_count;                          // 0 if unknown
+};
+
+// Frames of the sequence read ahead of the current one
+#define PGM_SEQUENCE_READ_AHEAD 4
+
+// Raw GRAY8 frames back to back, width x height each
+FrameSource* frame_source_open_raw(const char* path, int width, int height);
+// YUV4MPEG2 stream; the luma plane of each frame is used
+FrameSource* frame_source_open_y4m(const char* path);
+// Binary PGMs numbered by a printf pattern with one integer, e.g. "img/%05d.pgm",
+// starting at first_index and ending at the first missing file
+FrameSource* frame_source_open_pgm_sequence(const char* pattern, int first_index);
+
+// Attaches to a ring created by a capture process (see shm_frame_ring.h) and
+// reads its frames in place. With skip_to_latest each call returns the newest
+// frame published, otherwise every frame the writer did not drop. The stream
+// ends when the writer finishes, or with an error after timeout_ms without a
+// new frame.
+FrameSource* frame_source_open_shm(const char* name, int skip_to_latest, int timeout_ms);
+
+// By path: "shm:NAME" for a shared-memory ring, "synth:SPEC" for a generated
+// sequence (see synthetic_sequence.h), "*.y4m", a pattern with '%' (first index 0, or 1 if 0 is missing), or
+// raw GRAY8 if raw_width and raw_height are set. NULL if none applies.
+FrameSource* frame_source_open(const char* path, int raw_width, int raw_height);
+
+static inline int frame_source_next(FrameSource* src, Image* out) {
+    return src->next(src, out);
+}
+
+static inline void frame_source_close(FrameSource* src) {
+    if (src)
+        src->close(src);
+}
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef JSON_OUTPUT_H
+#define JSON_OUTPUT_H
+
+#include <stdio.h>
+
+// Writes s as a quoted JSON string, escaping quotes, backslashes and control characters
+static inline void json_string(FILE* out, const char* s) {
+    fputc('"', out);
+    for (; *s; ++s) {
+        if (*s == '"' || *s == '\\')
+            fprintf(out, "\\%c", *s);
+        else if ((unsigned char)*s < 0x20)
+            fprintf(out, "\\u%04x", (unsigned char)*s);
+        else
+            fputc(*s, out);
+    }
+    fputc('"', out);
+}
+
+#endif
@@ -2,10 +2,16 @@
 #include <stdlib.h>
 #include <string.h>
 #include "cmdline_parser.h"
+#include "frame_source.h"
+#include "results_log.h"
+#include "annotated_output.h"
 #include "tld_tracker.h"
 #include "unit_tests.h"
 #include "profile.h"
+#include "spsc_queue.h"
+#include <pthread.h>
 #include <stdint.h>
+#include <time.h>
 #include <libavformat/avformat.h>
 #include <libswscale/swscale.h>
 
@@ -31,56 +37,180 @@ typedef enum {
     printf("\n");
 }*/
 
-void avframe_to_gray_image(const AVFrame *frame, Image *out) {
-    int width = frame->width;
-    int height = frame->height;
-    out->width = width;
-    out->height = height;
-    out->data = malloc(width * height);
-
-    for (int y = 0; y < height; ++y) {
-        for (int x = 0; x < width; ++x) {
-            uint8_t r = frame->data[0][y * frame->linesize[0] + 3*x + 0];
-            uint8_t g = frame->data[0][y * frame->linesize[0] + 3*x + 1];
-            uint8_t b = frame->data[0][y * frame->linesize[0] + 3*x + 2];
-            uint8_t gray = (uint8_t)((r * 30 + g * 59 + b * 11) / 100); // ITU-R BT.601
-            out->data[y * width + x] = gray;
-        }
+static int64_t monotonic_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Where per-frame results go besides the tracker; the log and the annotated
+// output do their I/O on their own threads
+typedef struct {
+    int debug;
+    ResultsLog *log;
+    AnnotatedOutput *annotated;
+} AppOutputs;
+
+static void report_frame(const AppOutputs *out, const TldTracker *tracker, const Image *frame,
+                         size_t frame_id, Candidate result) {
+    if (out->log) {
+        ResultsLogFrame record;
+        results_log_frame_from_tracker(&record, tracker, frame_id, monotonic_us(), result);
+        results_log_frame(out->log, &record);
+    }
+    if (out->annotated)
+        annotated_output_submit(out->annotated, frame, frame_id, result, tracker);
+    if (out->debug) {
+        printf("[DEBUG] Frame %zu: Candidate @ (%d, %d, %d, %d), prob=%.3f\n",
+            frame_id, result.strobe.x, result.strobe.y, result.strobe.width, result.strobe.height, result.prob);
+    }
+}
+
+// Decoded frames waiting for the tracking stage
+#define DECODE_QUEUE_DEPTH 4
+// Frames in flight: the queued ones, the tracker's current and previous ones
+// and the one being decoded
+#define DECODE_POOL_SIZE (DECODE_QUEUE_DEPTH + 3)
+
+// Formats whose first plane is the 8-bit luma are handed to the tracker as is;
+// anything else is converted by swscale straight to GRAY8 into gray, which has
+// the tracker's border so the conversion and its padding stay on the decode side.
+typedef struct {
+    AVFrame* av;
+    Image gray;
+    Image img;     // what the tracker sees: a view of av or gray
+} DecodedFrame;
+
+// Decode and tracking stages, one thread each, joined by two SPSC queues: the
+// decoder fills recycled frames and passes them on through ready, the tracker
+// hands them back once they are no longer its previous frame. A NULL in ready
+// marks the end of the stream.
+typedef struct {
+    AVFormatContext* fmt_ctx;
+    AVCodecContext* dec_ctx;
+    int video_stream_idx;
+    int borrow_luma;
+    struct SwsContext* sws_ctx;   // NULL when the luma is borrowed
+    DecodedFrame pool[DECODE_POOL_SIZE];
+    SpscQueue ready;
+    SpscQueue recycled;
+} DecodePipeline;
+
+static int pix_fmt_has_luma_plane(enum AVPixelFormat fmt) {
+    switch (fmt) {
+        case AV_PIX_FMT_GRAY8:
+        case AV_PIX_FMT_YUV420P:
+        case AV_PIX_FMT_YUV422P:
+        case AV_PIX_FMT_YUV444P:
+        case AV_PIX_FMT_YUV410P:
+        case AV_PIX_FMT_YUV411P:
+        case AV_PIX_FMT_YUV440P:
+        case AV_PIX_FMT_YUVJ420P:
+        case AV_PIX_FMT_YUVJ422P:
+        case AV_PIX_FMT_YUVJ444P:
+        case AV_PIX_FMT_YUVJ440P:
+        case AV_PIX_FMT_YUVA420P:
+        case AV_PIX_FMT_NV12:
+        case AV_PIX_FMT_NV21:
+        case AV_PIX_FMT_NV16:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+int decode_pipeline_init(DecodePipeline* pipe, AVFormatContext* fmt_ctx, AVCodecContext* dec_ctx,
+                         int video_stream_idx) {
+    memset(pipe, 0, sizeof(DecodePipeline));
+    pipe->fmt_ctx = fmt_ctx;
+    pipe->dec_ctx = dec_ctx;
+    pipe->video_stream_idx = video_stream_idx;
+    pipe->borrow_luma = pix_fmt_has_luma_plane(dec_ctx->pix_fmt);
+    if (!pipe->borrow_luma) {
+        pipe->sws_ctx = sws_getContext(dec_ctx->width, dec_ctx->height, dec_ctx->pix_fmt,
+                                       dec_ctx->width, dec_ctx->height, AV_PIX_FMT_GRAY8,
+                                       SWS_BICUBIC, NULL, NULL, NULL);
+        if (!pipe->sws_ctx)
+            return 0;
     }
+    if (!spsc_queue_init(&pipe->ready, DECODE_QUEUE_DEPTH + 1) ||
+        !spsc_queue_init(&pipe->recycled, DECODE_POOL_SIZE))
+        return 0;
+    for (int i = 0; i < DECODE_POOL_SIZE; ++i) {
+        pipe->pool[i].av = av_frame_alloc();
+        if (!pipe->pool[i].av)
+            return 0;
+        spsc_queue_try_push(&pipe->recycled, &pipe->pool[i]);
+    }
+    return 1;
 }
 
-// Reads the next frame from video, converts to RGB24, returns 1 if frame is read, 0 if end/error
-int get_next_gray_frame(AVFormatContext *fmt_ctx, AVCodecContext *dec_ctx, int video_stream_idx,
-                        struct SwsContext *sws_ctx, AVFrame *frame_rgb, Image *out_img) {
+void decode_pipeline_free(DecodePipeline* pipe) {
+    for (int i = 0; i < DECODE_POOL_SIZE; ++i) {
+        av_frame_free(&pipe->pool[i].av);
+        image_free(&pipe->pool[i].gray);
+    }
+    spsc_queue_free(&pipe->ready);
+    spsc_queue_free(&pipe->recycled);
+    sws_freeContext(pipe->sws_ctx);
+    pipe->sws_ctx = NULL;
+}
+
+// Reads the next frame from video into out as a gray image, returns 1 if frame is read, 0 if end/error
+static int decode_next_frame(DecodePipeline *pipe, DecodedFrame *out) {
     AVPacket pkt;
     int got_frame = 0;
-    while (av_read_frame(fmt_ctx, &pkt) >= 0) {
-        if (pkt.stream_index == video_stream_idx) {
-            AVFrame *frame = av_frame_alloc();
-            int ret, got_picture;
-            ret = avcodec_send_packet(dec_ctx, &pkt);
-            if (ret < 0) { av_frame_free(&frame); av_packet_unref(&pkt); continue; }
-            got_picture = avcodec_receive_frame(dec_ctx, frame);
-            if (got_picture == 0) {
-                // Convert to RGB24
-                sws_scale(sws_ctx, (const uint8_t * const*)frame->data, frame->linesize, 0, dec_ctx->height,
-                          frame_rgb->data, frame_rgb->linesize);
-                // Convert RGB24 to grayscale Image
-                avframe_to_gray_image(frame_rgb, out_img);
+    av_frame_unref(out->av);
+    while (av_read_frame(pipe->fmt_ctx, &pkt) >= 0) {
+        if (pkt.stream_index == pipe->video_stream_idx) {
+            int ret = avcodec_send_packet(pipe->dec_ctx, &pkt);
+            if (ret < 0) { av_packet_unref(&pkt); continue; }
+            if (avcodec_receive_frame(pipe->dec_ctx, out->av) == 0) {
+                AVFrame *frame = out->av;
+                if (pipe->borrow_luma) {
+                    out->img.width = frame->width;
+                    out->img.height = frame->height;
+                    out->img.stride = frame->linesize[0];
+                    out->img.border = 0;
+                    out->img.data = frame->data[0];
+                } else {
+                    Image *dst = &out->gray;
+                    if (!dst->data || dst->width != frame->width || dst->height != frame->height) {
+                        image_free(dst);
+                        *dst = image_create_padded(frame->width, frame->height, TLD_FRAME_BORDER);
+                        if (!dst->data) { av_packet_unref(&pkt); break; }
+                    }
+                    uint8_t *dst_planes[4] = { dst->data, NULL, NULL, NULL };
+                    int dst_strides[4] = { dst->stride, 0, 0, 0 };
+                    sws_scale(pipe->sws_ctx, (const uint8_t * const*)frame->data, frame->linesize, 0,
+                              frame->height, dst_planes, dst_strides);
+                    image_replicate_border(dst);
+                    out->img = *dst;
+                }
                 got_frame = 1;
-                av_frame_free(&frame);
                 av_packet_unref(&pkt);
                 break;
             }
-            av_frame_free(&frame);
         }
         av_packet_unref(&pkt);
     }
     return got_frame;
 }
 
+static void* decode_stage(void* arg) {
+    DecodePipeline *pipe = (DecodePipeline*)arg;
+    while (1) {
+        DecodedFrame *slot = (DecodedFrame*)spsc_queue_pop(&pipe->recycled);
+        if (!decode_next_frame(pipe, slot))
+            break;
+        spsc_queue_push(&pipe->ready, slot);
+    }
+    spsc_queue_push(&pipe->ready, NULL);
+    return NULL;
+}
+
 // Main tracking loop
-void run_app_ffmpeg(const char *video_path, int debug) {
+void run_app_ffmpeg(const char *video_path, const AppOutputs *out) {
     av_register_all();
     AVFormatContext *fmt_ctx = NULL;
     if (avformat_open_input(&fmt_ctx, video_path, NULL, NULL) != 0) {
@@ -112,74 +242,131 @@ void run_app_ffmpeg(const char *video_path, int debug) {
     avcodec_parameters_to_context(dec_ctx, codecpar);
     avcodec_open2(dec_ctx, codec, NULL);
 
-    int width = dec_ctx->width;
-    int height = dec_ctx->height;
-    struct SwsContext *sws_ctx = sws_getContext(width, height, dec_ctx->pix_fmt,
-                                                width, height, AV_PIX_FMT_RGB24,
-                                                SWS_BICUBIC, NULL, NULL, NULL);
-    AVFrame *frame_rgb = av_frame_alloc();
-    int num_bytes = avpicture_get_size(AV_PIX_FMT_RGB24, width, height);
-    uint8_t *buffer = av_malloc(num_bytes);
-    avpicture_fill((AVPicture*)frame_rgb, buffer, AV_PIX_FMT_RGB24, width, height);
+    DecodePipeline pipeline;
+    pthread_t decode_thread;
+    if (!decode_pipeline_init(&pipeline, fmt_ctx, dec_ctx, video_stream_idx) ||
+        pthread_create(&decode_thread, NULL, decode_stage, &pipeline) != 0) {
+        fprintf(stderr, "Failed to set up the decode stage\n");
+        decode_pipeline_free(&pipeline);
+        avcodec_free_context(&dec_ctx);
+        avformat_close_input(&fmt_ctx);
+        return;
+    }
 
     TldTracker tracker;
     tld_tracker_init(&tracker, default_settings());
+    DecodedFrame *prev = NULL;
     size_t frame_id = 0;
     while (1) {
-        Image gray;
-        int got = get_next_gray_frame(fmt_ctx, dec_ctx, video_stream_idx, sws_ctx, frame_rgb, &gray);
-        if (!got) break;
+        DecodedFrame *cur = (DecodedFrame*)spsc_queue_pop(&pipeline.ready);
+        if (!cur) break;
 
-        Candidate result = tld_tracker_process_frame(&tracker, &gray);
+        Candidate result = tld_tracker_process_frame_borrowed(&tracker, &cur->img);
+        report_frame(out, &tracker, &cur->img, frame_id, result);
+        // The tracker no longer reads the frame before this one
+        if (prev)
+            spsc_queue_push(&pipeline.recycled, prev);
+        prev = cur;
 
-        if (debug) {
-            printf("[DEBUG] Frame %zu: Candidate @ (%d, %d, %d, %d), prob=%.3f\n",
-                frame_id, result.strobe.x, result.strobe.y, result.strobe.width, result.strobe.height, result.prob);
-        }
-        draw_candidate(&gray, result);
-
-        // Optionally save debug images (implement save_image_png or similar)
-        // char fname[128];
-        // sprintf(fname, "frame_%zu.png", frame_id);
-        // save_image_png(fname, &gray);
 
         if (frame_id == 0) {
             Rect bbox = {117,231,105,79};
             tld_tracker_start_tracking(&tracker, bbox);
         }
-        free(gray.data);
         frame_id++;
     }
 
+    pthread_join(decode_thread, NULL);
     tld_tracker_free(&tracker);
-    av_free(buffer);
-    av_frame_free(&frame_rgb);
-    sws_freeContext(sws_ctx);
+    decode_pipeline_free(&pipeline);
     avcodec_free_context(&dec_ctx);
     avformat_close_input(&fmt_ctx);
 }
+// Tracking loop over a mapped frame source: frames are views into the mapping,
+// so there is nothing to decode or copy
+void run_app_frame_source(FrameSource *source, const AppOutputs *out) {
+    TldTracker tracker;
+    tld_tracker_init(&tracker, default_settings());
+    size_t frame_id = 0;
+    Image frame;
+    int ret;
+    while ((ret = frame_source_next(source, &frame)) == 1) {
+        Candidate result = tld_tracker_process_frame_borrowed(&tracker, &frame);
+        report_frame(out, &tracker, &frame, frame_id, result);
+        if (frame_id == 0) {
+            Rect bbox = {117,231,105,79};
+            tld_tracker_start_tracking(&tracker, bbox);
+        }
+        frame_id++;
+    }
+    if (ret < 0)
+        fprintf(stderr, "Frame source error after %zu frames\n", frame_id);
+    tld_tracker_free(&tracker);
+}
+
 int main(int argc, char** argv) {
     const char *video_path = "/mnt/tmp/scene1.mp4";
     int debug = 0;
+    int raw_width = 0, raw_height = 0;
+    const char *log_path = NULL;
+    const char *annotate_path = NULL;
 
     // Minimal argument parsing
     for (int i = 1; i < argc; ++i) {
         if (strcmp(argv[i], "--help") == 0) {
-            printf("Usage: %s [--videopath=PATH] [--debug]\n", argv[0]);
+            printf("Usage: %s [--videopath=PATH] [--rawsize=WxH] [--log=PATH] [--annotate=PATH] [--debug]\n", argv[0]);
             printf("  --videopath=PATH  Set input video file path (default: %s)\n", video_path);
+            printf("                    *.y4m and PGM patterns such as img/%%05d.pgm are read directly\n");
+            printf("  --rawsize=WxH     Read PATH as raw GRAY8 frames of this size\n");
+            printf("  --log=PATH        Write per-frame results to a binary log (see tools/results_log_convert)\n");
+            printf("  --annotate=PATH   Write frames with the boxes drawn: *.y4m, or a PGM pattern\n");
             printf("  --debug           Enable debug print\n");
             return 0;
         }
         if (strncmp(argv[i], "--videopath=", 12) == 0) {
             video_path = argv[i] + 12;
         }
+        if (strncmp(argv[i], "--rawsize=", 10) == 0) {
+            if (sscanf(argv[i] + 10, "%dx%d", &raw_width, &raw_height) != 2) {
+                fprintf(stderr, "Bad --rawsize, expected WxH\n");
+                return 1;
+            }
+        }
+        if (strncmp(argv[i], "--log=", 6) == 0) {
+            log_path = argv[i] + 6;
+        }
+        if (strncmp(argv[i], "--annotate=", 11) == 0) {
+            annotate_path = argv[i] + 11;
+        }
         if (strcmp(argv[i], "--debug") == 0) {
             debug = 1;
         }
     }
 
-    // Call the tracking runner
-    run_app_ffmpeg(video_path, debug);
+    AppOutputs outputs = { debug, NULL, NULL };
+    if (log_path) {
+        outputs.log = results_log_open(log_path);
+        if (!outputs.log) {
+            fprintf(stderr, "Cannot create log %s\n", log_path);
+            return 1;
+        }
+    }
+
+    // Call the tracking runner: mapped sources when the path is one, ffmpeg otherwise
+    FrameSource *source = frame_source_open(video_path, raw_width, raw_height);
+    if (annotate_path) {
+        outputs.annotated = annotated_output_open(annotate_path, source && source->fps > 0.0 ? source->fps : 30.0);
+        if (!outputs.annotated)
+            fprintf(stderr, "Cannot create annotated output %s, going on without it\n", annotate_path);
+    }
+    if (source) {
+        run_app_frame_source(source, &outputs);
+        frame_source_close(source);
+    } else {
+        run_app_ffmpeg(video_path, &outputs);
+    }
+    annotated_output_close(outputs.annotated);
+    results_log_close(outputs.log);
 
     return 0;
 }
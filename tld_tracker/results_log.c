@@ -0,0 +1,323 @@
+#include "results_log.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Little-endian encoding, independent of the host and of struct padding
+
+static uint8_t* put_u8(uint8_t* p, uint32_t v) {
+    *p = (uint8_t)v;
+    return p + 1;
+}
+
+static uint8_t* put_u16(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    return p + 2;
+}
+
+static uint8_t* put_u32(uint8_t* p, uint32_t v) {
+    for (int i = 0; i < 4; ++i)
+        p[i] = (uint8_t)(v >> (8 * i));
+    return p + 4;
+}
+
+static uint8_t* put_u64(uint8_t* p, uint64_t v) {
+    for (int i = 0; i < 8; ++i)
+        p[i] = (uint8_t)(v >> (8 * i));
+    return p + 8;
+}
+
+static uint8_t* put_f32(uint8_t* p, double v) {
+    float f = (float)v;
+    uint32_t bits;
+    memcpy(&bits, &f, 4);
+    return put_u32(p, bits);
+}
+
+static uint8_t* put_candidate(uint8_t* p, const Candidate* c) {
+    p = put_u32(p, (uint32_t)c->strobe.x);
+    p = put_u32(p, (uint32_t)c->strobe.y);
+    p = put_u32(p, (uint32_t)c->strobe.width);
+    p = put_u32(p, (uint32_t)c->strobe.height);
+    p = put_f32(p, c->prob);
+    p = put_f32(p, c->aux_prob);
+    p = put_u8(p, c->valid ? 1 : 0);
+    return put_u8(p, (uint32_t)c->src);
+}
+
+static const uint8_t* get_u16(const uint8_t* p, uint32_t* v) {
+    *v = (uint32_t)p[0] | (uint32_t)p[1] << 8;
+    return p + 2;
+}
+
+static const uint8_t* get_u32(const uint8_t* p, uint32_t* v) {
+    *v = 0;
+    for (int i = 0; i < 4; ++i)
+        *v |= (uint32_t)p[i] << (8 * i);
+    return p + 4;
+}
+
+static const uint8_t* get_u64(const uint8_t* p, uint64_t* v) {
+    *v = 0;
+    for (int i = 0; i < 8; ++i)
+        *v |= (uint64_t)p[i] << (8 * i);
+    return p + 8;
+}
+
+static const uint8_t* get_i32(const uint8_t* p, int* v) {
+    uint32_t u;
+    p = get_u32(p, &u);
+    *v = (int)(int32_t)u;
+    return p;
+}
+
+static const uint8_t* get_f32(const uint8_t* p, double* v) {
+    uint32_t bits;
+    float f;
+    p = get_u32(p, &bits);
+    memcpy(&f, &bits, 4);
+    *v = f;
+    return p;
+}
+
+static const uint8_t* get_candidate(const uint8_t* p, Candidate* c) {
+    p = get_i32(p, &c->strobe.x);
+    p = get_i32(p, &c->strobe.y);
+    p = get_i32(p, &c->strobe.width);
+    p = get_i32(p, &c->strobe.height);
+    p = get_f32(p, &c->prob);
+    p = get_f32(p, &c->aux_prob);
+    c->valid = p[0];
+    c->src = p[1];
+    return p + 2;
+}
+
+// Frame record without the proposal lists and the message text
+#define FRAME_RECORD_FIXED (4 + 1 + 8 + 8 + 2 * RESULTS_LOG_CANDIDATE_SIZE + 17 + 2 + 2 + 1)
+
+static size_t encode_frame(uint8_t* out, const ResultsLogFrame* frame) {
+    const char* message = frame->status.message ? frame->status.message : "";
+    size_t message_len = strlen(message);
+    if (message_len > 255)
+        message_len = 255;
+    // Proposal lists are cut to fit, clusters first as they are the smaller
+    size_t room = (RESULTS_LOG_MAX_RECORD - FRAME_RECORD_FIXED - message_len) / RESULTS_LOG_CANDIDATE_SIZE;
+    size_t clusters = frame->clusters_count > 0 ? (size_t)frame->clusters_count : 0;
+    if (clusters > room) clusters = room;
+    size_t proposals = frame->proposals_count > 0 ? (size_t)frame->proposals_count : 0;
+    if (proposals > room - clusters) proposals = room - clusters;
+    if (proposals > 0xffff) proposals = 0xffff;
+    if (clusters > 0xffff) clusters = 0xffff;
+
+    const TldStatus* st = &frame->status;
+    uint32_t flags = (st->training ? RESULTS_LOG_STATUS_TRAINING : 0) |
+                     (st->processing ? RESULTS_LOG_STATUS_PROCESSING : 0) |
+                     (st->fast_path ? RESULTS_LOG_STATUS_FAST_PATH : 0) |
+                     (st->valid_object ? RESULTS_LOG_STATUS_VALID : 0) |
+                     (st->tracker_relocation ? RESULTS_LOG_STATUS_RELOCATION : 0);
+    uint8_t* p = out + 4;
+    p = put_u8(p, RESULTS_LOG_FRAME);
+    p = put_u64(p, frame->frame_id);
+    p = put_u64(p, (uint64_t)frame->timestamp_us);
+    p = put_candidate(p, &frame->prediction);
+    p = put_u8(p, flags);
+    p = put_u32(p, (uint32_t)st->training_skipped_cnt);
+    p = put_u32(p, (uint32_t)st->detector_candidates_cnt);
+    p = put_u32(p, (uint32_t)st->detector_clusters_cnt);
+    p = put_u32(p, (uint32_t)st->active_ferns_cnt);
+    p = put_candidate(p, &frame->tracker_proposal);
+    p = put_u16(p, (uint32_t)proposals);
+    for (size_t i = 0; i < proposals; ++i)
+        p = put_candidate(p, &frame->proposals[i]);
+    p = put_u16(p, (uint32_t)clusters);
+    for (size_t i = 0; i < clusters; ++i)
+        p = put_candidate(p, &frame->clusters[i]);
+    p = put_u8(p, (uint32_t)message_len);
+    memcpy(p, message, message_len);
+    p += message_len;
+    size_t size = (size_t)(p - out);
+    put_u32(out, (uint32_t)size);
+    return size;
+}
+
+static void sleep_ms(int ms) {
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000 };
+    nanosleep(&ts, NULL);
+}
+
+// Writes out what the ring holds, in at most two contiguous pieces
+static void results_log_drain(ResultsLog* log) {
+    size_t head = atomic_load_explicit(&log->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&log->tail, memory_order_acquire);
+    while (head != tail) {
+        size_t offset = head & (RESULTS_LOG_RING_SIZE - 1);
+        size_t len = tail - head;
+        if (len > RESULTS_LOG_RING_SIZE - offset)
+            len = RESULTS_LOG_RING_SIZE - offset;
+        fwrite(log->ring + offset, 1, len, log->file);
+        head += len;
+    }
+    atomic_store_explicit(&log->head, head, memory_order_release);
+
+    uint64_t dropped = atomic_load_explicit(&log->dropped, memory_order_relaxed);
+    if (dropped != log->dropped_logged) {
+        uint8_t rec[4 + 1 + 8];
+        uint8_t* p = put_u32(rec, sizeof(rec));
+        p = put_u8(p, RESULTS_LOG_DROPPED);
+        put_u64(p, dropped - log->dropped_logged);
+        fwrite(rec, 1, sizeof(rec), log->file);
+        log->dropped_logged = dropped;
+    }
+    fflush(log->file);
+}
+
+static void* results_log_writer(void* arg) {
+    ResultsLog* log = (ResultsLog*)arg;
+    while (!atomic_load_explicit(&log->stop, memory_order_acquire)) {
+        sleep_ms(RESULTS_LOG_FLUSH_MS);
+        results_log_drain(log);
+    }
+    results_log_drain(log);
+    return NULL;
+}
+
+ResultsLog* results_log_open(const char* path) {
+    ResultsLog* log = (ResultsLog*)calloc(1, sizeof(ResultsLog));
+    if (!log)
+        return NULL;
+    log->ring = (uint8_t*)malloc(RESULTS_LOG_RING_SIZE);
+    log->file = fopen(path, "wb");
+    if (!log->ring || !log->file) {
+        if (log->file)
+            fclose(log->file);
+        free(log->ring);
+        free(log);
+        return NULL;
+    }
+    setvbuf(log->file, NULL, _IOFBF, 1 << 16);
+    fwrite(RESULTS_LOG_MAGIC, 1, 8, log->file);
+    atomic_init(&log->head, 0);
+    atomic_init(&log->tail, 0);
+    atomic_init(&log->dropped, 0);
+    atomic_init(&log->stop, 0);
+    if (pthread_create(&log->writer, NULL, results_log_writer, log) != 0) {
+        fclose(log->file);
+        free(log->ring);
+        free(log);
+        return NULL;
+    }
+    return log;
+}
+
+void results_log_close(ResultsLog* log) {
+    if (!log)
+        return;
+    atomic_store_explicit(&log->stop, 1, memory_order_release);
+    pthread_join(log->writer, NULL);
+    fclose(log->file);
+    free(log->ring);
+    free(log);
+}
+
+int results_log_frame(ResultsLog* log, const ResultsLogFrame* frame) {
+    size_t size = encode_frame(log->record, frame);
+    size_t tail = atomic_load_explicit(&log->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&log->head, memory_order_acquire);
+    if (RESULTS_LOG_RING_SIZE - (tail - head) < size) {
+        atomic_fetch_add_explicit(&log->dropped, 1, memory_order_relaxed);
+        return 0;
+    }
+    size_t offset = tail & (RESULTS_LOG_RING_SIZE - 1);
+    size_t first = RESULTS_LOG_RING_SIZE - offset;
+    if (first > size)
+        first = size;
+    memcpy(log->ring + offset, log->record, first);
+    memcpy(log->ring, log->record + first, size - first);
+    atomic_store_explicit(&log->tail, tail + size, memory_order_release);
+    return 1;
+}
+
+int results_log_reader_open(ResultsLogReader* reader, const char* path) {
+    char magic[8];
+    reader->file = fopen(path, "rb");
+    if (!reader->file)
+        return 0;
+    if (fread(magic, 1, 8, reader->file) != 8 || memcmp(magic, RESULTS_LOG_MAGIC, 8) != 0) {
+        fclose(reader->file);
+        reader->file = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+void results_log_reader_close(ResultsLogReader* reader) {
+    if (reader->file)
+        fclose(reader->file);
+    reader->file = NULL;
+}
+
+int results_log_read(ResultsLogReader* reader, ResultsLogFrame* frame, uint64_t* dropped) {
+    uint8_t* rec = reader->record;
+    size_t got = fread(rec, 1, 4, reader->file);
+    if (got == 0)
+        return 0;
+    uint32_t size;
+    get_u32(rec, &size);
+    if (got != 4 || size < 5 || size > RESULTS_LOG_MAX_RECORD ||
+        fread(rec + 4, 1, size - 4, reader->file) != size - 4)
+        return -1;
+    const uint8_t* p = rec + 5;
+    const uint8_t* end = rec + size;
+    if (rec[4] == RESULTS_LOG_DROPPED) {
+        if (size != 13)
+            return -1;
+        get_u64(p, dropped);
+        return RESULTS_LOG_DROPPED;
+    }
+    if (rec[4] != RESULTS_LOG_FRAME || size < FRAME_RECORD_FIXED)
+        return -1;
+
+    uint64_t u;
+    uint32_t n;
+    p = get_u64(p, &frame->frame_id);
+    p = get_u64(p, &u);
+    frame->timestamp_us = (int64_t)u;
+    p = get_candidate(p, &frame->prediction);
+    TldStatus* st = &frame->status;
+    uint32_t flags = *p++;
+    st->training = (flags & RESULTS_LOG_STATUS_TRAINING) != 0;
+    st->processing = (flags & RESULTS_LOG_STATUS_PROCESSING) != 0;
+    st->fast_path = (flags & RESULTS_LOG_STATUS_FAST_PATH) != 0;
+    st->valid_object = (flags & RESULTS_LOG_STATUS_VALID) != 0;
+    st->tracker_relocation = (flags & RESULTS_LOG_STATUS_RELOCATION) != 0;
+    p = get_i32(p, &st->training_skipped_cnt);
+    p = get_i32(p, &st->detector_candidates_cnt);
+    p = get_i32(p, &st->detector_clusters_cnt);
+    p = get_i32(p, &st->active_ferns_cnt);
+    p = get_candidate(p, &frame->tracker_proposal);
+
+    p = get_u16(p, &n);
+    if ((size_t)(end - p) < (size_t)n * RESULTS_LOG_CANDIDATE_SIZE + 3)
+        return -1;
+    for (uint32_t i = 0; i < n; ++i)
+        p = get_candidate(p, &reader->proposals[i]);
+    frame->proposals = reader->proposals;
+    frame->proposals_count = (int)n;
+
+    p = get_u16(p, &n);
+    if ((size_t)(end - p) < (size_t)n * RESULTS_LOG_CANDIDATE_SIZE + 1)
+        return -1;
+    for (uint32_t i = 0; i < n; ++i)
+        p = get_candidate(p, &reader->clusters[i]);
+    frame->clusters = reader->clusters;
+    frame->clusters_count = (int)n;
+
+    n = *p++;
+    if ((size_t)(end - p) < n)
+        return -1;
+    memcpy(reader->message, p, n);
+    reader->message[n] = '\0';
+    st->message = reader->message;
+    return RESULTS_LOG_FRAME;
+}
@@ -0,0 +1,109 @@
+#ifndef RESULTS_LOG_H
+#define RESULTS_LOG_H
+
+#include "tld_tracker.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Binary per-frame results log. The file starts with an 8-byte magic
+// "TLDLOG\0\1"; records follow, all fields little-endian:
+//   u32 size (whole record), u8 type
+//   RESULTS_LOG_FRAME:   u64 frame_id, i64 timestamp_us, candidate prediction,
+//                        status, candidate tracker_proposal,
+//                        u16 n, n x candidate detector proposals,
+//                        u16 m, m x candidate clusters, u8 len, len x status message
+//   RESULTS_LOG_DROPPED: u64 records dropped since the previous such record
+// candidate: i32 x, y, width, height, f32 prob, aux_prob, u8 valid, u8 src
+// status:    u8 flags (RESULTS_LOG_STATUS_*), i32 training_skipped_cnt,
+//            detector_candidates_cnt, detector_clusters_cnt, active_ferns_cnt
+
+#define RESULTS_LOG_MAGIC "TLDLOG\0\1"
+#define RESULTS_LOG_FRAME 1
+#define RESULTS_LOG_DROPPED 2
+
+#define RESULTS_LOG_CANDIDATE_SIZE 26
+
+#define RESULTS_LOG_STATUS_TRAINING   0x01
+#define RESULTS_LOG_STATUS_PROCESSING 0x02
+#define RESULTS_LOG_STATUS_FAST_PATH  0x04
+#define RESULTS_LOG_STATUS_VALID      0x08
+#define RESULTS_LOG_STATUS_RELOCATION 0x10
+
+// Larger records have their proposal lists cut
+#define RESULTS_LOG_MAX_RECORD 16384
+#define RESULTS_LOG_RING_SIZE (1 << 20)
+#define RESULTS_LOG_FLUSH_MS 20
+
+// One frame's results, as handed to results_log_frame or read back
+typedef struct {
+    uint64_t frame_id;
+    int64_t timestamp_us;
+    Candidate prediction;
+    TldStatus status;
+    Candidate tracker_proposal;
+    const Candidate* proposals;
+    int proposals_count;
+    const Candidate* clusters;
+    int clusters_count;
+} ResultsLogFrame;
+
+// The tracking thread encodes records into a byte ring and never waits: a
+// record that does not fit is dropped and counted. A writer thread empties the
+// ring into the file in batches every RESULTS_LOG_FLUSH_MS.
+typedef struct {
+    FILE* file;
+    uint8_t* ring;
+    _Alignas(64) atomic_size_t head;   // written out up to here, by the writer
+    _Alignas(64) atomic_size_t tail;   // encoded up to here, by the tracking thread
+    atomic_uint_least64_t dropped;
+    atomic_int stop;
+    uint64_t dropped_logged;
+    uint8_t record[RESULTS_LOG_MAX_RECORD];
+    pthread_t writer;
+} ResultsLog;
+
+// NULL if the file cannot be created
+ResultsLog* results_log_open(const char* path);
+// Writes out everything queued, then closes the file
+void results_log_close(ResultsLog* log);
+// Returns 0 if the record was dropped
+int results_log_frame(ResultsLog* log, const ResultsLogFrame* frame);
+
+// Fills frame from the tracker after a frame was processed. The proposal lists
+// are views of the tracker's state: log the frame before the next one.
+static inline void results_log_frame_from_tracker(ResultsLogFrame* frame, const TldTracker* tracker,
+                                                  uint64_t frame_id, int64_t timestamp_us,
+                                                  Candidate prediction) {
+    CandidateArray proposals = tld_tracker_get_detector_proposals(tracker);
+    CandidateArray clusters = tld_tracker_get_clusters(tracker);
+    frame->frame_id = frame_id;
+    frame->timestamp_us = timestamp_us;
+    frame->prediction = prediction;
+    frame->status = tld_tracker_get_status(tracker);
+    frame->tracker_proposal = tld_tracker_get_tracker_proposal(tracker);
+    frame->proposals = proposals.data;
+    frame->proposals_count = proposals.count;
+    frame->clusters = clusters.data;
+    frame->clusters_count = clusters.count;
+}
+
+// Reading back, for the conversion tool
+
+typedef struct {
+    FILE* file;
+    uint8_t record[RESULTS_LOG_MAX_RECORD];
+    Candidate proposals[RESULTS_LOG_MAX_RECORD / RESULTS_LOG_CANDIDATE_SIZE];
+    Candidate clusters[RESULTS_LOG_MAX_RECORD / RESULTS_LOG_CANDIDATE_SIZE];
+    char message[256];
+} ResultsLogReader;
+
+int results_log_reader_open(ResultsLogReader* reader, const char* path);
+void results_log_reader_close(ResultsLogReader* reader);
+// Next record: returns its type, 0 at the end, -1 if the log is corrupt.
+// frame (pointing into the reader) is filled for RESULTS_LOG_FRAME records,
+// *dropped for RESULTS_LOG_DROPPED ones.
+int results_log_read(ResultsLogReader* reader, ResultsLogFrame* frame, uint64_t* dropped);
+
+#endif
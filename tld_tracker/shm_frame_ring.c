@@ -0,0 +1,155 @@
+#include "shm_frame_ring.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static size_t align_size(size_t v, size_t a) {
+    return (v + a - 1) / a * a;
+}
+
+int shm_frame_ring_create(ShmFrameRing* ring, const char* name, int width, int height, int slot_count) {
+    memset(ring, 0, sizeof(ShmFrameRing));
+    if (width <= 0 || height <= 0 || slot_count < 3 || slot_count > SHM_FRAME_RING_MAX_SLOTS)
+        return 0;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t stride = align_size((size_t)width, SHM_FRAME_RING_ALIGN);
+    size_t slot_size = align_size(stride * height, page);
+    size_t data_offset = align_size(sizeof(ShmFrameRingHeader), page);
+    size_t size = data_offset + slot_size * slot_count;
+
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0)
+        return 0;
+    void* base = MAP_FAILED;
+    if (ftruncate(fd, (off_t)size) == 0)
+        base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        shm_unlink(name);
+        return 0;
+    }
+    // A fresh object is zero-filled: only the geometry needs writing. magic goes
+    // last, so a reader attaching meanwhile sees either nothing or all of it.
+    ShmFrameRingHeader* h = (ShmFrameRingHeader*)base;
+    h->version = SHM_FRAME_RING_VERSION;
+    h->width = (uint32_t)width;
+    h->height = (uint32_t)height;
+    h->stride = (uint32_t)stride;
+    h->slot_count = (uint32_t)slot_count;
+    h->slot_size = slot_size;
+    h->data_offset = data_offset;
+    atomic_thread_fence(memory_order_release);
+    h->magic = SHM_FRAME_RING_MAGIC;
+
+    ring->header = h;
+    ring->base = (uint8_t*)base;
+    ring->size = size;
+    ring->owner = 1;
+    snprintf(ring->name, sizeof(ring->name), "%s", name);
+    return 1;
+}
+
+int shm_frame_ring_attach(ShmFrameRing* ring, const char* name) {
+    memset(ring, 0, sizeof(ShmFrameRing));
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0)
+        return 0;
+    struct stat st;
+    void* base = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(ShmFrameRingHeader))
+        base = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return 0;
+    ShmFrameRingHeader* h = (ShmFrameRingHeader*)base;
+    atomic_thread_fence(memory_order_acquire);
+    if (h->magic != SHM_FRAME_RING_MAGIC || h->version != SHM_FRAME_RING_VERSION ||
+        h->slot_count < 3 || h->slot_count > SHM_FRAME_RING_MAX_SLOTS ||
+        h->data_offset + h->slot_size * h->slot_count > (uint64_t)st.st_size) {
+        munmap(base, (size_t)st.st_size);
+        return 0;
+    }
+    ring->header = h;
+    ring->base = (uint8_t*)base;
+    ring->size = (size_t)st.st_size;
+    snprintf(ring->name, sizeof(ring->name), "%s", name);
+    return 1;
+}
+
+void shm_frame_ring_close(ShmFrameRing* ring) {
+    if (ring->header && !ring->owner)
+        atomic_store(&ring->header->reader_attached, 0);
+    if (ring->base)
+        munmap(ring->base, ring->size);
+    if (ring->owner)
+        shm_unlink(ring->name);
+    memset(ring, 0, sizeof(ShmFrameRing));
+}
+
+// The slot of frame n holds frame n - slot_count, which the reader may still
+// use. A held slot is refused without touching its seq, so that a reader
+// fetching that frame never sees it change. Otherwise seq is cleared before
+// read_hold is checked again, and the reader sets read_hold before checking
+// seq: with both sequentially consistent, either the writer sees the hold of
+// a reader that has just attached or that reader sees the cleared seq and
+// skips the frame. read_hold only grows while a reader is attached, so the
+// second check can only fail for a reader attaching in between.
+uint8_t* shm_frame_ring_begin_write(ShmFrameRing* ring) {
+    ShmFrameRingHeader* h = ring->header;
+    uint64_t n = atomic_load_explicit(&h->write_seq, memory_order_relaxed);
+    if (n >= h->slot_count) {
+        if (atomic_load(&h->reader_attached) && n - h->slot_count >= atomic_load(&h->read_hold))
+            return NULL;
+        ShmFrameSlot* slot = &h->slots[n % h->slot_count];
+        uint64_t old = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+        atomic_store(&slot->seq, 0);
+        if (atomic_load(&h->reader_attached) && n - h->slot_count >= atomic_load(&h->read_hold)) {
+            atomic_store_explicit(&slot->seq, old, memory_order_relaxed);
+            return NULL;
+        }
+    }
+    return shm_frame_ring_slot_data(ring, n);
+}
+
+void shm_frame_ring_commit(ShmFrameRing* ring, int64_t timestamp_us) {
+    ShmFrameRingHeader* h = ring->header;
+    uint64_t n = atomic_load_explicit(&h->write_seq, memory_order_relaxed);
+    ShmFrameSlot* slot = &h->slots[n % h->slot_count];
+    slot->timestamp_us = timestamp_us;
+    atomic_store_explicit(&slot->seq, n + 1, memory_order_release);
+    atomic_store_explicit(&h->write_seq, n + 1, memory_order_release);
+}
+
+void shm_frame_ring_drop(ShmFrameRing* ring) {
+    atomic_fetch_add_explicit(&ring->header->dropped, 1, memory_order_relaxed);
+}
+
+void shm_frame_ring_finish(ShmFrameRing* ring) {
+    atomic_store_explicit(&ring->header->closed, 1, memory_order_release);
+}
+
+uint64_t shm_frame_ring_reader_start(ShmFrameRing* ring) {
+    ShmFrameRingHeader* h = ring->header;
+    uint64_t n = atomic_load_explicit(&h->write_seq, memory_order_acquire);
+    uint64_t first = n > 0 ? n - 1 : 0;
+    atomic_store(&h->read_hold, first);
+    atomic_store(&h->reader_attached, 1);
+    return first;
+}
+
+void shm_frame_ring_hold(ShmFrameRing* ring, uint64_t frame) {
+    atomic_store(&ring->header->read_hold, frame);
+}
+
+int shm_frame_ring_frame_ready(const ShmFrameRing* ring, uint64_t frame, int64_t* timestamp_us) {
+    ShmFrameRingHeader* h = ring->header;
+    ShmFrameSlot* slot = &h->slots[frame % h->slot_count];
+    if (atomic_load(&slot->seq) != frame + 1)
+        return 0;
+    if (timestamp_us)
+        *timestamp_us = slot->timestamp_us;
+    return 1;
+}
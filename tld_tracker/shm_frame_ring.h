@@ -0,0 +1,78 @@
+#ifndef SHM_FRAME_RING_H
+#define SHM_FRAME_RING_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Ring of GRAY8 frames in a POSIX shared-memory object, written by one process
+// (the capture side) and read in place by one other (the tracker).
+//
+// Frame n goes to slot n % slot_count. The writer fills the slot, then stores
+// n + 1 in the slot's seq and in write_seq (both release). The reader
+// publishes in read_hold the oldest frame it still refers to, and the writer
+// never overwrites a frame >= read_hold while a reader is attached: frames are
+// read in place, without a copy and without tearing. When the reader lags,
+// the writer drops new frames (counted in dropped) instead of waiting.
+
+#define SHM_FRAME_RING_MAGIC 0x524d4454u   // "TDMR"
+#define SHM_FRAME_RING_VERSION 1
+#define SHM_FRAME_RING_ALIGN 64
+#define SHM_FRAME_RING_MAX_SLOTS 64
+
+typedef struct {
+    _Alignas(SHM_FRAME_RING_ALIGN) atomic_uint_least64_t seq;   // frame number + 1, 0 if never written
+    int64_t timestamp_us;                                        // as given by the writer
+} ShmFrameSlot;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width, height;
+    uint32_t stride;                 // bytes between rows, a multiple of SHM_FRAME_RING_ALIGN
+    uint32_t slot_count;
+    uint64_t slot_size;              // bytes between frames
+    uint64_t data_offset;            // of slot 0 from the start of the object
+    _Alignas(SHM_FRAME_RING_ALIGN) atomic_uint_least64_t write_seq;   // frames published
+    atomic_uint_least64_t dropped;
+    atomic_int closed;               // writer is done
+    _Alignas(SHM_FRAME_RING_ALIGN) atomic_uint_least64_t read_hold;
+    atomic_int reader_attached;
+    ShmFrameSlot slots[SHM_FRAME_RING_MAX_SLOTS];
+} ShmFrameRingHeader;
+
+typedef struct {
+    ShmFrameRingHeader* header;
+    uint8_t* base;
+    size_t size;
+    char name[256];
+    int owner;                       // created it: unlinks it on close
+} ShmFrameRing;
+
+// name is a shm_open name ("/tld_frames"). Both return 0 on failure.
+int shm_frame_ring_create(ShmFrameRing* ring, const char* name, int width, int height, int slot_count);
+int shm_frame_ring_attach(ShmFrameRing* ring, const char* name);
+// Closing a reader lets the writer overwrite everything again
+void shm_frame_ring_close(ShmFrameRing* ring);
+
+static inline uint8_t* shm_frame_ring_slot_data(const ShmFrameRing* ring, uint64_t frame) {
+    const ShmFrameRingHeader* h = ring->header;
+    return ring->base + h->data_offset + (frame % h->slot_count) * h->slot_size;
+}
+
+// Writer: buffer for the next frame (stride bytes per row), or NULL if its slot
+// is still held by the reader: drop the frame or retry later. commit publishes it.
+uint8_t* shm_frame_ring_begin_write(ShmFrameRing* ring);
+void shm_frame_ring_commit(ShmFrameRing* ring, int64_t timestamp_us);
+void shm_frame_ring_drop(ShmFrameRing* ring);
+void shm_frame_ring_finish(ShmFrameRing* ring);
+
+// Reader: marks the reader attached, holding every frame from the newest one
+// published (returned, 0 if none yet) on
+uint64_t shm_frame_ring_reader_start(ShmFrameRing* ring);
+// Frames before frame may be overwritten from now on
+void shm_frame_ring_hold(ShmFrameRing* ring, uint64_t frame);
+// 1 if frame has been published and its slot still holds it
+int shm_frame_ring_frame_ready(const ShmFrameRing* ring, uint64_t frame, int64_t* timestamp_us);
+
+#endif
@@ -0,0 +1,514 @@
+#include "synthetic_sequence.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define SYNTHETIC_TILE_SIZE 1024      // background period, a power of two
+#define SYNTHETIC_SCALE_PERIOD 180.0  // frames per scale oscillation
+#define SYNTHETIC_ROTATION_PERIOD 240.0
+
+typedef struct {
+    double center_x, center_y;
+    double scale;
+    double angle;                     // radians
+} SyntheticPose;
+
+// Integer hash (lowbias32); all randomness derives from it, so that frames
+// do not depend on rand() state or on rendering order
+static uint32_t hash32(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+
+static uint32_t hash3(uint32_t seed, uint32_t a, uint32_t b) {
+    return hash32(seed ^ hash32(a * 0x9E3779B1U ^ hash32(b + 0x632BE5ABU)));
+}
+
+// Smoothly interpolated lattice noise in [0, 1]; the lattice wraps every
+// period cells if period is not 0
+static double value_noise(uint32_t seed, double x, double y, double cell, int period) {
+    double fx = x / cell, fy = y / cell;
+    int ix = (int)floor(fx), iy = (int)floor(fy);
+    double tx = fx - ix, ty = fy - iy;
+    tx = tx * tx * (3.0 - 2.0 * tx);
+    ty = ty * ty * (3.0 - 2.0 * ty);
+    int ix1 = ix + 1, iy1 = iy + 1;
+    if (period > 0) {
+        ix = ((ix % period) + period) % period;
+        iy = ((iy % period) + period) % period;
+        ix1 = ix1 % period;
+        iy1 = iy1 % period;
+    }
+    double v00 = hash3(seed, (uint32_t)ix, (uint32_t)iy) & 0xFFFF;
+    double v01 = hash3(seed, (uint32_t)ix1, (uint32_t)iy) & 0xFFFF;
+    double v10 = hash3(seed, (uint32_t)ix, (uint32_t)iy1) & 0xFFFF;
+    double v11 = hash3(seed, (uint32_t)ix1, (uint32_t)iy1) & 0xFFFF;
+    double top = v00 + (v01 - v00) * tx;
+    double bottom = v10 + (v11 - v10) * tx;
+    return (top + (bottom - top) * ty) / 65535.0;
+}
+
+static uint8_t clamp_pixel(double v) {
+    return (uint8_t)(v < 0.0 ? 0 : (v > 255.0 ? 255 : (int)(v + 0.5)));
+}
+
+// Blotches at a few scales with a dark outline: strong gradients for the
+// flow tracker and distinctive pixel comparisons for the ferns
+static void render_object_texture(Image* img, uint32_t seed) {
+    double coarse = fmax(4.0, fmin(img->width, img->height) / 5.0);
+    for (int y = 0; y < img->height; ++y) {
+        uint8_t* row = image_row(img, y);
+        for (int x = 0; x < img->width; ++x) {
+            double v = 0.65 * value_noise(seed, x, y, coarse, 0) + 0.35 * value_noise(seed + 1, x, y, 3.0, 0);
+            int edge = x < 2 || y < 2 || x >= img->width - 2 || y >= img->height - 2;
+            row[x] = edge ? 20 : clamp_pixel(20.0 + (v - 0.2) / 0.6 * 215.0);
+        }
+    }
+}
+
+// Lower contrast than the object, periodic so that it can pan without end
+static void render_background_tile(Image* img, uint32_t seed, SyntheticBackground background) {
+    for (int y = 0; y < img->height; ++y) {
+        uint8_t* row = image_row(img, y);
+        for (int x = 0; x < img->width; ++x) {
+            if (background == SYNTHETIC_BACKGROUND_FLAT) {
+                row[x] = 110;
+                continue;
+            }
+            double v = 0.55 * value_noise(seed, x, y, 64.0, SYNTHETIC_TILE_SIZE / 64) +
+                       0.30 * value_noise(seed + 1, x, y, 16.0, SYNTHETIC_TILE_SIZE / 16) +
+                       0.15 * value_noise(seed + 2, x, y, 4.0, SYNTHETIC_TILE_SIZE / 4);
+            row[x] = clamp_pixel(50.0 + v * 120.0);
+        }
+    }
+}
+
+void synthetic_settings_default(SyntheticSettings* s) {
+    s->width = 1280;
+    s->height = 720;
+    s->frames = 300;
+    s->fps = 30.0;
+    s->seed = 1;
+    s->object_width = 64;
+    s->object_height = 48;
+    s->path = SYNTHETIC_PATH_WANDER;
+    s->speed = 3.0;
+    s->scale_range = 0.2;
+    s->rotation_range = 10.0;
+    s->occlusion_period = 0;
+    s->occlusion_frames = 0;
+    s->distractors = 0;
+    s->background = SYNTHETIC_BACKGROUND_TEXTURED;
+    s->pan_x = 0.0;
+    s->pan_y = 0.0;
+    s->noise = 2;
+}
+
+static int parse_pair_int(const char* value, char separator, int* a, int* b) {
+    char* end;
+    long x = strtol(value, &end, 10);
+    if (end == value || *end != separator)
+        return 0;
+    const char* second = end + 1;
+    long y = strtol(second, &end, 10);
+    if (end == second || *end != '\0')
+        return 0;
+    *a = (int)x;
+    *b = (int)y;
+    return 1;
+}
+
+static int parse_pair_double(const char* value, double* a, double* b) {
+    char* end;
+    *a = strtod(value, &end);
+    if (end == value || *end != ':')
+        return 0;
+    const char* second = end + 1;
+    *b = strtod(second, &end);
+    return end != second && *end == '\0';
+}
+
+static int parse_double(const char* value, double* out) {
+    char* end;
+    *out = strtod(value, &end);
+    return end != value && *end == '\0';
+}
+
+static int parse_int(const char* value, int* out) {
+    char* end;
+    long v = strtol(value, &end, 10);
+    *out = (int)v;
+    return end != value && *end == '\0';
+}
+
+static int parse_setting(SyntheticSettings* s, const char* key, const char* value) {
+    int v;
+    if (strcmp(key, "frames") == 0) {
+        if (!parse_int(value, &v) || v < 0)
+            return 0;
+        s->frames = (size_t)v;
+        return 1;
+    }
+    if (strcmp(key, "seed") == 0) {
+        char* end;
+        s->seed = (uint32_t)strtoul(value, &end, 10);
+        return end != value && *end == '\0';
+    }
+    if (strcmp(key, "fps") == 0)
+        return parse_double(value, &s->fps) && s->fps > 0.0;
+    if (strcmp(key, "object") == 0)
+        return parse_pair_int(value, 'x', &s->object_width, &s->object_height) &&
+               s->object_width >= 8 && s->object_height >= 8;
+    if (strcmp(key, "path") == 0) {
+        static const char* names[] = { "bounce", "circle", "lissajous", "wander" };
+        for (int i = 0; i < 4; ++i)
+            if (strcmp(value, names[i]) == 0) {
+                s->path = (SyntheticPath)i;
+                return 1;
+            }
+        return 0;
+    }
+    if (strcmp(key, "speed") == 0)
+        return parse_double(value, &s->speed) && s->speed >= 0.0;
+    if (strcmp(key, "scale") == 0)
+        return parse_double(value, &s->scale_range) && s->scale_range >= 0.0 && s->scale_range < 0.9;
+    if (strcmp(key, "rotation") == 0)
+        return parse_double(value, &s->rotation_range);
+    if (strcmp(key, "occlusion") == 0)
+        return parse_pair_int(value, ':', &s->occlusion_period, &s->occlusion_frames) &&
+               s->occlusion_frames >= 0 && s->occlusion_frames <= s->occlusion_period;
+    if (strcmp(key, "distractors") == 0)
+        return parse_int(value, &s->distractors) && s->distractors >= 0 &&
+               s->distractors <= SYNTHETIC_MAX_DISTRACTORS;
+    if (strcmp(key, "background") == 0) {
+        if (strcmp(value, "flat") == 0)
+            s->background = SYNTHETIC_BACKGROUND_FLAT;
+        else if (strcmp(value, "textured") == 0)
+            s->background = SYNTHETIC_BACKGROUND_TEXTURED;
+        else
+            return 0;
+        return 1;
+    }
+    if (strcmp(key, "pan") == 0)
+        return parse_pair_double(value, &s->pan_x, &s->pan_y);
+    if (strcmp(key, "noise") == 0)
+        return parse_int(value, &s->noise) && s->noise >= 0 && s->noise <= 127;
+    return 0;
+}
+
+int synthetic_settings_parse(SyntheticSettings* s, const char* spec) {
+    char token[256];
+    const char* p = spec;
+    int first = 1;
+    while (*p) {
+        size_t len = strcspn(p, ",");
+        if (len == 0 || len >= sizeof(token))
+            return 0;
+        memcpy(token, p, len);
+        token[len] = '\0';
+        p += len + (p[len] == ',' ? 1 : 0);
+        char* eq = strchr(token, '=');
+        if (!eq) {
+            // The frame size, only as the first token
+            if (!first || !parse_pair_int(token, 'x', &s->width, &s->height) || s->width < 16 || s->height < 16)
+                return 0;
+        } else {
+            *eq = '\0';
+            if (!parse_setting(s, token, eq + 1))
+                return 0;
+        }
+        first = 0;
+    }
+    return 1;
+}
+
+int synthetic_sequence_init(SyntheticSequence* seq, const SyntheticSettings* settings) {
+    memset(seq, 0, sizeof(SyntheticSequence));
+    seq->settings = *settings;
+    const SyntheticSettings* s = &seq->settings;
+    if (s->distractors > SYNTHETIC_MAX_DISTRACTORS || s->width < s->object_width || s->height < s->object_height)
+        return 0;
+    seq->object = image_create_padded(s->object_width, s->object_height, 0);
+    seq->tile = image_create_padded(SYNTHETIC_TILE_SIZE, SYNTHETIC_TILE_SIZE, 0);
+    if (!seq->object.data || !seq->tile.data) {
+        synthetic_sequence_free(seq);
+        return 0;
+    }
+    render_object_texture(&seq->object, hash32(s->seed ^ 0x0B1EC7U));
+    render_background_tile(&seq->tile, hash32(s->seed ^ 0xBAC6U), s->background);
+
+    // Objects stay entirely inside the frame at any scale and angle
+    double max_scale = 1.0 + s->scale_range;
+    double half_w = 0.5 * s->object_width * max_scale, half_h = 0.5 * s->object_height * max_scale;
+    if (s->rotation_range != 0.0)
+        half_w = half_h = sqrt(half_w * half_w + half_h * half_h);
+    seq->extent_x = fmax(0.0, 0.5 * s->width - half_w - 1.0);
+    seq->extent_y = fmax(0.0, 0.5 * s->height - half_h - 1.0);
+
+    for (int k = 0; k <= s->distractors; ++k)
+        for (int i = 0; i < 4; ++i)
+            seq->phase[k][i] = (hash3(s->seed, (uint32_t)k, (uint32_t)i) & 0xFFFFFF) / (double)0x1000000 * 2.0 * M_PI;
+    return 1;
+}
+
+void synthetic_sequence_free(SyntheticSequence* seq) {
+    image_free(&seq->object);
+    image_free(&seq->tile);
+}
+
+// Triangle wave of slope +-1 between -1 and 1, period 4
+static double triangle(double p) {
+    double q = fmod(p, 4.0);
+    if (q < 0.0)
+        q += 4.0;
+    return q < 2.0 ? q - 1.0 : 3.0 - q;
+}
+
+// Pose of object k (0 is the target) at frame t, in closed form
+static SyntheticPose synthetic_pose(const SyntheticSequence* seq, int k, double t) {
+    const SyntheticSettings* s = &seq->settings;
+    const double* ph = seq->phase[k];
+    double ex = fmax(seq->extent_x, 1.0), ey = fmax(seq->extent_y, 1.0);
+    double radius = 0.5 * (ex + ey);
+    double u = 0.0, v = 0.0;
+    switch (s->path) {
+    case SYNTHETIC_PATH_BOUNCE:
+        u = triangle(ph[0] / M_PI * 2.0 + t * s->speed * cos(ph[2]) / ex);
+        v = triangle(ph[1] / M_PI * 2.0 + t * s->speed * sin(ph[2]) / ey);
+        break;
+    case SYNTHETIC_PATH_CIRCLE: {
+        double a = ph[0] + t * s->speed / radius * (k % 2 ? -1.0 : 1.0);
+        u = cos(a);
+        v = sin(a);
+        break;
+    }
+    case SYNTHETIC_PATH_LISSAJOUS: {
+        double a = ph[0] + t * s->speed / (1.6 * radius);
+        u = sin(a);
+        v = sin(2.0 * a);
+        break;
+    }
+    case SYNTHETIC_PATH_WANDER: {
+        double w = s->speed / radius;
+        u = (sin(0.8 * w * t + ph[0]) + 0.5 * sin(1.9 * w * t + ph[1])) / 1.5;
+        v = (sin(0.7 * w * t + ph[2]) + 0.5 * sin(2.3 * w * t + ph[3])) / 1.5;
+        break;
+    }
+    }
+    SyntheticPose pose;
+    pose.center_x = 0.5 * s->width + u * seq->extent_x;
+    pose.center_y = 0.5 * s->height + v * seq->extent_y;
+    pose.scale = 1.0 + s->scale_range * sin(2.0 * M_PI * t / SYNTHETIC_SCALE_PERIOD + ph[2]);
+    pose.angle = s->rotation_range * M_PI / 180.0 * sin(2.0 * M_PI * t / SYNTHETIC_ROTATION_PERIOD + ph[3]);
+    return pose;
+}
+
+// Bounds of the rotated, scaled object; all pixels drawn for it are inside box
+static void pose_bounds(const SyntheticSequence* seq, SyntheticPose pose, double* x, double* y,
+                        double* width, double* height, Rect* box) {
+    double half_w = 0.5 * seq->settings.object_width * pose.scale;
+    double half_h = 0.5 * seq->settings.object_height * pose.scale;
+    double c = fabs(cos(pose.angle)), s = fabs(sin(pose.angle));
+    double ex = half_w * c + half_h * s, ey = half_w * s + half_h * c;
+    *x = pose.center_x - ex;
+    *y = pose.center_y - ey;
+    *width = 2.0 * ex;
+    *height = 2.0 * ey;
+    // Pixels are drawn when their centers fall on the object
+    box->x = (int)ceil(*x - 0.5);
+    box->y = (int)ceil(*y - 0.5);
+    box->width = (int)ceil(pose.center_x + ex - 0.5) - box->x;
+    box->height = (int)ceil(pose.center_y + ey - 0.5) - box->y;
+}
+
+// Occluder over the target at frame index, or an empty rect. It sweeps from
+// left to right and covers the whole box half way through.
+static Rect synthetic_occluder(const SyntheticSequence* seq, size_t index, Rect box) {
+    const SyntheticSettings* s = &seq->settings;
+    Rect none = { 0, 0, 0, 0 };
+    if (s->occlusion_period <= 0 || s->occlusion_frames <= 0 || index < (size_t)s->occlusion_period)
+        return none;
+    size_t q = index % (size_t)s->occlusion_period;
+    if (q >= (size_t)s->occlusion_frames)
+        return none;
+    double p = (q + 0.5) / s->occlusion_frames;
+    Rect bar;
+    bar.width = box.width;
+    bar.x = box.x - bar.width + (int)floor(p * 2.0 * bar.width + 0.5);
+    bar.y = box.y - box.height / 4;
+    bar.height = box.height + box.height / 2;
+    return bar;
+}
+
+static int intersection_area(Rect a, Rect b) {
+    int x0 = a.x > b.x ? a.x : b.x, y0 = a.y > b.y ? a.y : b.y;
+    int x1 = a.x + a.width < b.x + b.width ? a.x + a.width : b.x + b.width;
+    int y1 = a.y + a.height < b.y + b.height ? a.y + a.height : b.y + b.height;
+    return x1 > x0 && y1 > y0 ? (x1 - x0) * (y1 - y0) : 0;
+}
+
+SyntheticTruth synthetic_sequence_truth(const SyntheticSequence* seq, size_t index) {
+    SyntheticPose pose = synthetic_pose(seq, 0, (double)index);
+    SyntheticTruth truth;
+    pose_bounds(seq, pose, &truth.x, &truth.y, &truth.width, &truth.height, &truth.box);
+    truth.center_x = pose.center_x;
+    truth.center_y = pose.center_y;
+    truth.scale = pose.scale;
+    truth.angle = pose.angle * 180.0 / M_PI;
+    Rect bar = synthetic_occluder(seq, index, truth.box);
+    truth.occlusion = (double)intersection_area(bar, truth.box) / rect_area(truth.box);
+    truth.valid = truth.occlusion < SYNTHETIC_VISIBLE_FRACTION;
+    return truth;
+}
+
+// Inverse mapping: each pixel center in the bounds is taken back to texture
+// coordinates and, if it falls on the object, sampled bilinearly
+static void draw_object(const SyntheticSequence* seq, SyntheticPose pose, Image* out) {
+    const Image* tex = &seq->object;
+    double x, y, width, height;
+    Rect box;
+    pose_bounds(seq, pose, &x, &y, &width, &height, &box);
+    double ca = cos(pose.angle), sa = sin(pose.angle), inv = 1.0 / pose.scale;
+    int x0 = box.x < 0 ? 0 : box.x, y0 = box.y < 0 ? 0 : box.y;
+    int x1 = box.x + box.width > out->width ? out->width : box.x + box.width;
+    int y1 = box.y + box.height > out->height ? out->height : box.y + box.height;
+    for (int j = y0; j < y1; ++j) {
+        uint8_t* row = image_row(out, j);
+        double dy = j + 0.5 - pose.center_y;
+        for (int i = x0; i < x1; ++i) {
+            double dx = i + 0.5 - pose.center_x;
+            double u = (dx * ca + dy * sa) * inv + 0.5 * tex->width;
+            double v = (-dx * sa + dy * ca) * inv + 0.5 * tex->height;
+            if (u < 0.0 || v < 0.0 || u >= tex->width || v >= tex->height)
+                continue;
+            double fu = u - 0.5, fv = v - 0.5;
+            int iu = (int)floor(fu), iv = (int)floor(fv);
+            double tu = fu - iu, tv = fv - iv;
+            int iu0 = iu < 0 ? 0 : iu, iv0 = iv < 0 ? 0 : iv;
+            int iu1 = iu + 1 >= tex->width ? tex->width - 1 : iu + 1;
+            int iv1 = iv + 1 >= tex->height ? tex->height - 1 : iv + 1;
+            const uint8_t* r0 = image_row(tex, iv0);
+            const uint8_t* r1 = image_row(tex, iv1);
+            double top = r0[iu0] + (r0[iu1] - r0[iu0]) * tu;
+            double bottom = r1[iu0] + (r1[iu1] - r1[iu0]) * tu;
+            row[i] = clamp_pixel(top + (bottom - top) * tv);
+        }
+    }
+}
+
+static void draw_background(const SyntheticSequence* seq, size_t index, Image* out) {
+    const int mask = SYNTHETIC_TILE_SIZE - 1;
+    int ox = (int)((int64_t)floor(index * seq->settings.pan_x) & mask);
+    int oy = (int)((int64_t)floor(index * seq->settings.pan_y) & mask);
+    for (int y = 0; y < out->height; ++y) {
+        const uint8_t* src = image_row(&seq->tile, (y + oy) & mask);
+        uint8_t* dst = image_row(out, y);
+        int x = 0, sx = ox;
+        while (x < out->width) {
+            int n = SYNTHETIC_TILE_SIZE - sx;
+            if (n > out->width - x)
+                n = out->width - x;
+            memcpy(dst + x, src + sx, (size_t)n);
+            x += n;
+            sx = 0;
+        }
+    }
+}
+
+// Dark horizontal stripes, unlike both the object and the background
+static void draw_occluder(Rect bar, Image* out) {
+    int x0 = bar.x < 0 ? 0 : bar.x, y0 = bar.y < 0 ? 0 : bar.y;
+    int x1 = bar.x + bar.width > out->width ? out->width : bar.x + bar.width;
+    int y1 = bar.y + bar.height > out->height ? out->height : bar.y + bar.height;
+    for (int y = y0; y < y1; ++y)
+        if (x1 > x0)
+            memset(image_row(out, y) + x0, ((y - bar.y) / 6) % 2 ? 70 : 35, (size_t)(x1 - x0));
+}
+
+static void add_noise(uint32_t seed, size_t index, int amplitude, Image* out) {
+    uint32_t state = hash3(seed, (uint32_t)index, (uint32_t)((uint64_t)index >> 32)) | 1;
+    int range = 2 * amplitude + 1;
+    for (int y = 0; y < out->height; ++y) {
+        uint8_t* row = image_row(out, y);
+        for (int x = 0; x < out->width; ++x) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            int v = row[x] + (int)(((state >> 16) * (uint32_t)range) >> 16) - amplitude;
+            row[x] = (uint8_t)(v < 0 ? 0 : (v > 255 ? 255 : v));
+        }
+    }
+}
+
+void synthetic_sequence_render(const SyntheticSequence* seq, size_t index, Image* out) {
+    const SyntheticSettings* s = &seq->settings;
+    draw_background(seq, index, out);
+    // Distractors first: the target is never hidden by one of its copies
+    for (int k = s->distractors; k >= 0; --k)
+        draw_object(seq, synthetic_pose(seq, k, (double)index), out);
+    SyntheticTruth truth = synthetic_sequence_truth(seq, index);
+    draw_occluder(synthetic_occluder(seq, index, truth.box), out);
+    if (s->noise > 0)
+        add_noise(s->seed, index, s->noise, out);
+}
+
+// Frame source: the three most recent frames are kept, as the interface
+// promises
+typedef struct {
+    FrameSource base;
+    SyntheticSequence seq;
+    Image frames[3];
+    size_t next_index;
+} SyntheticSource;
+
+static int synthetic_next(FrameSource* src, Image* out) {
+    SyntheticSource* synth = (SyntheticSource*)src;
+    if (src->frame_count && synth->next_index >= src->frame_count)
+        return 0;
+    Image* frame = &synth->frames[synth->next_index % 3];
+    synthetic_sequence_render(&synth->seq, synth->next_index, frame);
+    synth->next_index++;
+    *out = *frame;
+    return 1;
+}
+
+static void synthetic_close(FrameSource* src) {
+    SyntheticSource* synth = (SyntheticSource*)src;
+    for (int i = 0; i < 3; ++i)
+        image_free(&synth->frames[i]);
+    synthetic_sequence_free(&synth->seq);
+    free(synth);
+}
+
+FrameSource* frame_source_open_synthetic(const SyntheticSettings* settings) {
+    SyntheticSource* synth = (SyntheticSource*)calloc(1, sizeof(SyntheticSource));
+    if (!synth)
+        return NULL;
+    if (!synthetic_sequence_init(&synth->seq, settings)) {
+        free(synth);
+        return NULL;
+    }
+    for (int i = 0; i < 3; ++i) {
+        synth->frames[i] = image_create_padded(settings->width, settings->height, 0);
+        if (!synth->frames[i].data) {
+            synthetic_close(&synth->base);
+            return NULL;
+        }
+    }
+    synth->base.next = synthetic_next;
+    synth->base.close = synthetic_close;
+    synth->base.width = settings->width;
+    synth->base.height = settings->height;
+    synth->base.fps = settings->fps;
+    synth->base.frame_count = settings->frames;
+    return &synth->base;
+}
@@ -0,0 +1,83 @@
+#ifndef SYNTHETIC_SEQUENCE_H
+#define SYNTHETIC_SEQUENCE_H
+
+#include "frame_source.h"
+#include "tld_utils.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define SYNTHETIC_MAX_DISTRACTORS 16
+// Ground truth is valid while less than this fraction of the box is occluded
+#define SYNTHETIC_VISIBLE_FRACTION 0.5
+
+typedef enum {
+    SYNTHETIC_PATH_BOUNCE,       // straight lines, reflected at the frame edges
+    SYNTHETIC_PATH_CIRCLE,
+    SYNTHETIC_PATH_LISSAJOUS,    // figure of eight
+    SYNTHETIC_PATH_WANDER        // smooth pseudo-random motion
+} SyntheticPath;
+
+typedef enum {
+    SYNTHETIC_BACKGROUND_FLAT,
+    SYNTHETIC_BACKGROUND_TEXTURED
+} SyntheticBackground;
+
+typedef struct {
+    int width, height;
+    size_t frames;               // 0: endless
+    double fps;
+    uint32_t seed;
+    int object_width, object_height;
+    SyntheticPath path;
+    double speed;                // pixels per frame (mean, for curved paths)
+    double scale_range;          // scale varies within 1 +- scale_range
+    double rotation_range;       // angle varies within +- rotation_range degrees
+    int occlusion_period;        // an occluder passes over the target every period frames (0: never)
+    int occlusion_frames;        // frames an occluder takes to pass
+    int distractors;             // copies of the object on their own paths
+    SyntheticBackground background;
+    double pan_x, pan_y;         // background motion, pixels per frame
+    int noise;                   // per-frame sensor noise amplitude (0: none)
+} SyntheticSettings;
+
+// Geometry the target was rendered with at one frame. x/y/width/height are
+// its exact bounds; box holds the pixels whose centers fall within them, so
+// it is tight for an upright object and at most a pixel wider per side than
+// the drawn corners of a rotated one.
+typedef struct {
+    Rect box;
+    double x, y, width, height;
+    double center_x, center_y;
+    double scale;
+    double angle;                // degrees
+    double occlusion;            // fraction of box covered by the occluder
+    int valid;
+} SyntheticTruth;
+
+// A sequence is a pure function of its settings: any frame can be rendered
+// on its own, in any order and on any thread, and always comes out the same.
+typedef struct {
+    SyntheticSettings settings;
+    Image object;                // object texture
+    Image tile;                  // periodic background texture
+    double extent_x, extent_y;   // path amplitude keeping objects inside the frame
+    double phase[SYNTHETIC_MAX_DISTRACTORS + 1][4];
+} SyntheticSequence;
+
+void synthetic_settings_default(SyntheticSettings* settings);
+// "WxH" followed by comma-separated key=value pairs, e.g.
+// "3840x2160,frames=600,seed=7,path=circle,speed=6,object=96x64,scale=0.3,
+// rotation=20,occlusion=120:30,distractors=2,background=textured,pan=1:0,noise=4".
+// Keys not given keep their values. Returns 0 on an unknown key or a bad value.
+int synthetic_settings_parse(SyntheticSettings* settings, const char* spec);
+
+int synthetic_sequence_init(SyntheticSequence* seq, const SyntheticSettings* settings);
+void synthetic_sequence_free(SyntheticSequence* seq);
+SyntheticTruth synthetic_sequence_truth(const SyntheticSequence* seq, size_t index);
+// out must be width x height
+void synthetic_sequence_render(const SyntheticSequence* seq, size_t index, Image* out);
+
+// Renders frames on demand; frame_count is 0 for an endless sequence
+FrameSource* frame_source_open_synthetic(const SyntheticSettings* settings);
+
+#endif
@@ -21,15 +21,26 @@ SOURCES += \
     tracker/augmentator.cpp \
     tracker/fern.cpp \
     tracker/fern_fext.cpp \
+    tracker/frame_cache.c \
+    tracker/frame_ring.c \
+    tracker/image_filter.c \
     tracker/integrator.cpp \
     tracker/object_detector.cpp \
     tracker/object_model.cpp \
     tracker/opt_flow_tracker.cpp \
+    tracker/pyr_lk.c \
     tracker/scanning_grid.cpp \
+    tracker/spsc_queue.c \
+    tracker/tld_async.c \
     tracker/tld_tracker.cpp \
     tracker/tld_utils.cpp \
     unit_tests.cpp \
-    cmdline_parser.cpp
+    cmdline_parser.cpp \
+    annotated_output.c \
+    frame_source.c \
+    results_log.c \
+    shm_frame_ring.c \
+    synthetic_sequence.c
 
 HEADERS += \
     profile.h \
@@ -38,26 +49,31 @@ HEADERS += \
     tracker/common.h \
     tracker/fern.h \
     tracker/fern_fext.h \
+    tracker/frame_cache.h \
+    tracker/frame_ring.h \
+    tracker/image_filter.h \
     tracker/integrator.h \
     tracker/object_classifier.h \
     tracker/object_detector.h \
     tracker/object_model.h \
     tracker/opt_flow_tracker.h \
+    tracker/pyr_lk.h \
     tracker/scanning_grid.h \
+    tracker/spsc_queue.h \
+    tracker/tld_async.h \
     tracker/tld_tracker.h \
     tracker/tld_utils.h \
     unit_tests.h \
-    cmdline_parser.h
+    cmdline_parser.h \
+    annotated_output.h \
+    frame_source.h \
+    results_log.h \
+    shm_frame_ring.h \
+    synthetic_sequence.h
 
-INCLUDEPATH += /usr/local/include/opencv4
-LIBS += -L/usr/local/lib \
-        -lopencv_core \
-        -lopencv_highgui \
-        -lopencv_videoio \
-        -lopencv_imgproc \
-        -lopencv_imgcodecs \
-        -lopencv_features2d \
-        -lopencv_video \
+LIBS += -lpthread \
+        -lrt \
+        -lm
 
 # Default rules for deployment.
 qnx: target.path = /tmp/$${TARGET}/bin
@@ -0,0 +1,489 @@
+// Microbenchmarks of the tracker's hot kernels, each timed in isolation on
+// synthetic data of realistic size. Per-frame kernels run over the list of
+// frame sizes, candidate kernels over the list of candidate counts.
+//
+// Each case is calibrated to --min-time, then timed in BENCH_REPEATS batches;
+// ns/op is the median batch, min the fastest one. bytes/op counts the pixels
+// and records a call has to touch, not the cache traffic it causes.
+#include "tld_utils.h"
+#include "image_filter.h"
+#include "fern_fext.h"
+#include "object_classifier.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_REPEATS 5
+#define BENCH_BORDER 16
+#define BENCH_MAX_SIZES 16
+#define BENCH_MAX_COUNTS 16
+#define BENCH_INPUTS 4096   // precomputed per-op inputs, cycled through
+
+typedef struct {
+    // Parameters
+    Size frame_size;
+    int count;
+    Size box;
+    Size patch;
+    int ksize;
+    double iou_threshold;
+    // Data
+    Image frame;
+    Image blurred;
+    BoxFilterScratch blur_scratch;
+    Image patches[2];
+    Rect rois[BENCH_INPUTS];
+    Candidate* candidates;
+    Candidate* clusters;
+    ScanningGrid grid;
+    FernFeatureExtractor extractor;
+    Size positions[MAX_SCALES];
+    size_t positions_count;
+    ObjectClassifier classifier;
+    size_t descriptors[BENCH_INPUTS];
+    uint64_t rng;
+    double sink;
+} BenchCase;
+
+typedef enum { BENCH_PER_FRAME, BENCH_PER_COUNT, BENCH_SINGLE } BenchAxis;
+
+typedef struct {
+    const char* name;
+    BenchAxis axis;
+    void (*setup)(BenchCase* c);
+    void (*run)(BenchCase* c, size_t iterations);
+    size_t (*bytes)(const BenchCase* c);
+} Kernel;
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// xorshift64*: the same seed gives the same data on every machine
+static uint32_t bench_random(BenchCase* c) {
+    c->rng ^= c->rng >> 12;
+    c->rng ^= c->rng << 25;
+    c->rng ^= c->rng >> 27;
+    return (uint32_t)((c->rng * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static int bench_random_int(BenchCase* c, int maxint) {
+    return maxint > 0 ? (int)(bench_random(c) % (uint32_t)maxint) : 0;
+}
+
+// Smooth texture plus noise, so that ROIs differ and nothing is constant
+static void fill_textured(BenchCase* c, Image* img) {
+    for (int y = 0; y < img->height; ++y) {
+        uint8_t* row = image_row(img, y);
+        for (int x = 0; x < img->width; ++x)
+            row[x] = (uint8_t)(((x * 7) ^ (y * 13)) + (bench_random(c) & 31));
+    }
+    image_replicate_border(img);
+}
+
+static Rect random_roi(BenchCase* c, Size box) {
+    Rect r;
+    r.width = box.width < c->frame_size.width ? box.width : c->frame_size.width;
+    r.height = box.height < c->frame_size.height ? box.height : c->frame_size.height;
+    r.x = bench_random_int(c, c->frame_size.width - r.width + 1);
+    r.y = bench_random_int(c, c->frame_size.height - r.height + 1);
+    return r;
+}
+
+static void setup_frame(BenchCase* c) {
+    c->frame = image_create_padded(c->frame_size.width, c->frame_size.height, BENCH_BORDER);
+    fill_textured(c, &c->frame);
+    for (size_t i = 0; i < BENCH_INPUTS; ++i)
+        c->rois[i] = random_roi(c, c->box);
+}
+
+// Detector output: a few targets, each with a cloud of overlapping boxes
+static void setup_candidates(BenchCase* c) {
+    c->candidates = (Candidate*)malloc(sizeof(Candidate) * (size_t)c->count);
+    c->clusters = (Candidate*)malloc(sizeof(Candidate) * (size_t)c->count);
+    int targets = 1 + c->count / 50;
+    for (int i = 0; i < c->count; ++i) {
+        Candidate* cand = &c->candidates[i];
+        int t = i % targets;
+        cand->strobe.width = c->box.width + bench_random_int(c, c->box.width / 4 + 1);
+        cand->strobe.height = c->box.height + bench_random_int(c, c->box.height / 4 + 1);
+        cand->strobe.x = t * c->box.width * 2 + bench_random_int(c, c->box.width / 3 + 1);
+        cand->strobe.y = t * c->box.height + bench_random_int(c, c->box.height / 3 + 1);
+        cand->prob = 0.5 + bench_random_int(c, 1000) / 2000.0;
+        cand->aux_prob = 0.0;
+        cand->valid = 1;
+        cand->src = PROPOSAL_SOURCE_DETECTOR;
+    }
+}
+
+static void run_fern_descriptor(BenchCase* c, size_t iterations) {
+    size_t scale_id = c->positions_count / 2;
+    Size positions = c->positions[scale_id];
+    int x = 0, y = 0;
+    BinaryDescriptor acc = 0;
+    for (size_t i = 0; i < iterations; ++i) {
+        acc ^= fern_feature_extractor_get_descriptor_by_position(&c->extractor, &c->frame, (Size){ x, y }, scale_id);
+        if (++x == positions.width) {
+            x = 0;
+            if (++y == positions.height)
+                y = 0;
+        }
+    }
+    c->sink += acc;
+}
+
+static void setup_fern_descriptor(BenchCase* c) {
+    static const double scales[] = { 0.8, 1.0, 1.2 };
+    setup_frame(c);
+    scanning_grid_init(&c->grid, c->frame_size, c->frame.stride);
+    scanning_grid_set_base(&c->grid, c->box, 0.1, scales, sizeof(scales) / sizeof(scales[0]));
+    scanning_grid_get_positions_cnt(&c->grid, c->positions, &c->positions_count);
+    fern_feature_extractor_init(&c->extractor, &c->grid);
+}
+
+// Two pixel reads per pair, plus the pair offsets
+static size_t bytes_fern_descriptor(const BenchCase* c) {
+    (void)c;
+    return BINARY_DESCRIPTOR_WIDTH * (2 + sizeof(PixelIdPair));
+}
+
+static void setup_classifier(BenchCase* c) {
+    object_classifier_init(&c->classifier, BINARY_DESCRIPTOR_CNT);
+    // A trained fern: most descriptors seen as negatives, some as positives
+    for (int i = 0; i < 20000; ++i) {
+        size_t x = (size_t)bench_random_int(c, BINARY_DESCRIPTOR_CNT);
+        if (bench_random_int(c, 8) == 0)
+            object_classifier_train_positive(&c->classifier, x);
+        else
+            object_classifier_train_negative(&c->classifier, x);
+    }
+    for (size_t i = 0; i < BENCH_INPUTS; ++i)
+        c->descriptors[i] = (size_t)bench_random_int(c, BINARY_DESCRIPTOR_CNT);
+}
+
+static void run_classifier(BenchCase* c, size_t iterations) {
+    double acc = 0.0;
+    for (size_t i = 0; i < iterations; ++i)
+        acc += object_classifier_predict(&c->classifier, c->descriptors[i & (BENCH_INPUTS - 1)]);
+    c->sink += acc;
+}
+
+// Cached flag and posterior of one descriptor
+static size_t bytes_classifier(const BenchCase* c) {
+    (void)c;
+    return sizeof(char) + sizeof(double);
+}
+
+static void setup_correlation(BenchCase* c) {
+    for (int k = 0; k < 2; ++k) {
+        c->patches[k] = image_create_padded(c->patch.width, c->patch.height, 0);
+        fill_textured(c, &c->patches[k]);
+    }
+}
+
+static void run_correlation(BenchCase* c, size_t iterations) {
+    double acc = 0.0;
+    for (size_t i = 0; i < iterations; ++i)
+        acc += images_correlation(&c->patches[0], &c->patches[1]);
+    c->sink += acc;
+}
+
+static size_t bytes_correlation(const BenchCase* c) {
+    return 2 * (size_t)c->patch.width * c->patch.height;
+}
+
+static void setup_blur(BenchCase* c) {
+    setup_frame(c);
+    c->blurred = image_create_padded(c->frame_size.width, c->frame_size.height, BENCH_BORDER);
+}
+
+// The tracker's path: box_filter with scratch kept between frames
+static void run_blur(BenchCase* c, size_t iterations) {
+    for (size_t i = 0; i < iterations; ++i)
+        box_filter(&c->frame, &c->blurred, c->ksize, NULL, &c->blur_scratch);
+    c->sink += c->blurred.data[0];
+}
+
+// One read and one write per pixel
+static size_t bytes_blur(const BenchCase* c) {
+    return 2 * (size_t)c->frame_size.width * c->frame_size.height;
+}
+
+static void run_iou(BenchCase* c, size_t iterations) {
+    double acc = 0.0;
+    for (size_t i = 0; i < iterations; ++i)
+        acc += compute_iou(c->rois[i & (BENCH_INPUTS - 1)], c->rois[(i + 1) & (BENCH_INPUTS - 1)]);
+    c->sink += acc;
+}
+
+static void setup_iou(BenchCase* c) {
+    // Boxes in a small area, so that most pairs overlap
+    c->frame_size = (Size){ c->box.width * 3, c->box.height * 3 };
+    for (size_t i = 0; i < BENCH_INPUTS; ++i)
+        c->rois[i] = random_roi(c, c->box);
+}
+
+static size_t bytes_iou(const BenchCase* c) {
+    (void)c;
+    return 2 * sizeof(Rect);
+}
+
+static void run_clusterize(BenchCase* c, size_t iterations) {
+    int acc = 0;
+    for (size_t i = 0; i < iterations; ++i)
+        acc += clusterize_candidates(c->candidates, c->count, c->iou_threshold, c->clusters);
+    c->sink += acc;
+}
+
+static size_t bytes_clusterize(const BenchCase* c) {
+    return 2 * sizeof(Candidate) * (size_t)c->count;
+}
+
+// Includes the allocation of the output, which the function does itself
+static void run_transform(BenchCase* c, size_t iterations) {
+    for (size_t i = 0; i < iterations; ++i) {
+        Image out;
+        size_t k = i & (BENCH_INPUTS - 1);
+        subframe_linear_transform(&c->frame, c->rois[k], (double)(k % 21) - 10.0, 0.9 + (k % 5) * 0.05,
+                                  (int)(k % 7) - 3, (int)(k % 5) - 2, &out);
+        c->sink += out.width ? out.data[0] : 0;
+        image_free(&out);
+    }
+}
+
+// Bilinear: four source pixels per output pixel, then the write
+static size_t bytes_transform(const BenchCase* c) {
+    return 5 * (size_t)c->box.width * c->box.height;
+}
+
+static void run_std_dev(BenchCase* c, size_t iterations) {
+    double acc = 0.0;
+    for (size_t i = 0; i < iterations; ++i)
+        acc += get_frame_std_dev(&c->frame, c->rois[i & (BENCH_INPUTS - 1)]);
+    c->sink += acc;
+}
+
+static size_t bytes_std_dev(const BenchCase* c) {
+    return (size_t)c->box.width * c->box.height;
+}
+
+static const Kernel kernels[] = {
+    { "fern_descriptor", BENCH_PER_FRAME, setup_fern_descriptor, run_fern_descriptor, bytes_fern_descriptor },
+    { "classifier_predict", BENCH_SINGLE, setup_classifier, run_classifier, bytes_classifier },
+    { "images_correlation", BENCH_SINGLE, setup_correlation, run_correlation, bytes_correlation },
+    { "blur_image", BENCH_PER_FRAME, setup_blur, run_blur, bytes_blur },
+    { "compute_iou", BENCH_SINGLE, setup_iou, run_iou, bytes_iou },
+    { "clusterize_candidates", BENCH_PER_COUNT, setup_candidates, run_clusterize, bytes_clusterize },
+    { "subframe_linear_transform", BENCH_PER_FRAME, setup_frame, run_transform, bytes_transform },
+    { "get_frame_std_dev", BENCH_PER_FRAME, setup_frame, run_std_dev, bytes_std_dev },
+};
+#define KERNELS_COUNT (sizeof(kernels) / sizeof(kernels[0]))
+
+static void bench_case_free(BenchCase* c) {
+    image_free(&c->frame);
+    image_free(&c->blurred);
+    image_free(&c->patches[0]);
+    image_free(&c->patches[1]);
+    box_filter_scratch_free(&c->blur_scratch);
+    free(c->classifier.positive_distribution);
+    free(c->classifier.negative_distribution);
+    free(c->classifier.posterior_prob_distribution);
+    free(c->classifier.updated);
+    free(c->candidates);
+    free(c->clusters);
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static void run_case(const Kernel* k, BenchCase* c, double min_time_ms, int csv) {
+    k->setup(c);
+    // Calibration: grow the batch until it takes a fifth of the time budget
+    int64_t batch_ns = (int64_t)(min_time_ms * 1e6) / BENCH_REPEATS;
+    size_t iterations = 1;
+    k->run(c, 1); // warm-up: page faults, lazy caches
+    for (;;) {
+        int64_t t0 = now_ns();
+        k->run(c, iterations);
+        int64_t elapsed = now_ns() - t0;
+        if (elapsed >= batch_ns)
+            break;
+        iterations *= elapsed > 0 && batch_ns / elapsed < 10 ? 2 : 10;
+    }
+    double ns_per_op[BENCH_REPEATS];
+    for (int r = 0; r < BENCH_REPEATS; ++r) {
+        int64_t t0 = now_ns();
+        k->run(c, iterations);
+        ns_per_op[r] = (double)(now_ns() - t0) / iterations;
+    }
+    qsort(ns_per_op, BENCH_REPEATS, sizeof(double), compare_doubles);
+    double median = ns_per_op[BENCH_REPEATS / 2];
+    size_t bytes = k->bytes(c);
+
+    char params[64];
+    if (k->axis == BENCH_PER_FRAME)
+        snprintf(params, sizeof(params), "%dx%d", c->frame_size.width, c->frame_size.height);
+    else if (k->axis == BENCH_PER_COUNT)
+        snprintf(params, sizeof(params), "n=%d", c->count);
+    else if (k->bytes == bytes_correlation)
+        snprintf(params, sizeof(params), "%dx%d", c->patch.width, c->patch.height);
+    else
+        snprintf(params, sizeof(params), "-");
+    if (csv)
+        printf("%s,%s,%zu,%.2f,%.2f,%zu,%.3f\n", k->name, params, iterations, median, ns_per_op[0], bytes,
+               bytes / median);
+    else
+        printf("%-26s %-12s %12zu %14.2f %14.2f %12zu %8.3f\n", k->name, params, iterations, median, ns_per_op[0],
+               bytes, bytes / median);
+    fflush(stdout);
+    bench_case_free(c);
+}
+
+// "a,b,c" into sizes; returns the number parsed
+static int parse_sizes(const char* s, Size* out, int max) {
+    int n = 0;
+    while (*s && n < max) {
+        int w, h, used = 0;
+        if (sscanf(s, "%dx%d%n", &w, &h, &used) != 2 || w <= 0 || h <= 0)
+            return 0;
+        out[n++] = (Size){ w, h };
+        s += used;
+        if (*s == ',')
+            ++s;
+    }
+    return n;
+}
+
+static int parse_counts(const char* s, int* out, int max) {
+    int n = 0;
+    while (*s && n < max) {
+        char* end;
+        long v = strtol(s, &end, 10);
+        if (end == s || v <= 0)
+            return 0;
+        out[n++] = (int)v;
+        s = *end == ',' ? end + 1 : end;
+    }
+    return n;
+}
+
+static int kernel_selected(const char* list, const char* name) {
+    if (!list)
+        return 1;
+    size_t len = strlen(name);
+    for (const char* p = list; *p;) {
+        const char* end = strchr(p, ',');
+        size_t n = end ? (size_t)(end - p) : strlen(p);
+        if (n == len && strncmp(p, name, n) == 0)
+            return 1;
+        p += n + (end ? 1 : 0);
+    }
+    return 0;
+}
+
+static void print_help(const char* prog) {
+    printf("Usage: %s [options]\n", prog);
+    printf("  --kernels=LIST    comma-separated kernels (default: all)\n");
+    printf("  --sizes=LIST      frame sizes, e.g. 640x480,3840x2160 (default: VGA, 720p, 1080p, 4K)\n");
+    printf("  --counts=LIST     candidate counts (default: 1,10,100,1000)\n");
+    printf("  --box=WxH         object box for ROIs, grids and transforms (default: 64x64)\n");
+    printf("  --patch=WxH       correlation patch (default: 15x15)\n");
+    printf("  --ksize=N         blur kernel size (default: 7)\n");
+    printf("  --iou=X           clustering threshold (default: 0.5)\n");
+    printf("  --min-time=MS     time budget per case (default: 200)\n");
+    printf("  --seed=N          data seed (default: 1)\n");
+    printf("  --csv             comma-separated output\n");
+    printf("  --list            print the kernel names\n");
+    printf("Kernels:");
+    for (size_t i = 0; i < KERNELS_COUNT; ++i)
+        printf(" %s", kernels[i].name);
+    printf("\n");
+}
+
+int main(int argc, char** argv) {
+    Size sizes[BENCH_MAX_SIZES] = { { 640, 480 }, { 1280, 720 }, { 1920, 1080 }, { 3840, 2160 } };
+    int sizes_count = 4;
+    int counts[BENCH_MAX_COUNTS] = { 1, 10, 100, 1000 };
+    int counts_count = 4;
+    Size box = { 64, 64 }, patch = { 15, 15 };
+    int ksize = 7, csv = 0;
+    double iou = 0.5, min_time_ms = 200.0;
+    unsigned long long seed = 1;
+    const char* selected = NULL;
+
+    for (int i = 1; i < argc; ++i) {
+        int ok = 1;
+        if (strcmp(argv[i], "--help") == 0) {
+            print_help(argv[0]);
+            return 0;
+        } else if (strcmp(argv[i], "--list") == 0) {
+            for (size_t k = 0; k < KERNELS_COUNT; ++k)
+                printf("%s\n", kernels[k].name);
+            return 0;
+        } else if (strncmp(argv[i], "--kernels=", 10) == 0) {
+            selected = argv[i] + 10;
+        } else if (strncmp(argv[i], "--sizes=", 8) == 0) {
+            ok = (sizes_count = parse_sizes(argv[i] + 8, sizes, BENCH_MAX_SIZES)) > 0;
+        } else if (strncmp(argv[i], "--counts=", 9) == 0) {
+            ok = (counts_count = parse_counts(argv[i] + 9, counts, BENCH_MAX_COUNTS)) > 0;
+        } else if (strncmp(argv[i], "--box=", 6) == 0) {
+            ok = parse_sizes(argv[i] + 6, &box, 1) == 1;
+        } else if (strncmp(argv[i], "--patch=", 8) == 0) {
+            ok = parse_sizes(argv[i] + 8, &patch, 1) == 1;
+        } else if (strncmp(argv[i], "--ksize=", 8) == 0) {
+            ksize = atoi(argv[i] + 8);
+        } else if (strncmp(argv[i], "--iou=", 6) == 0) {
+            iou = atof(argv[i] + 6);
+        } else if (strncmp(argv[i], "--min-time=", 11) == 0) {
+            min_time_ms = atof(argv[i] + 11);
+        } else if (strncmp(argv[i], "--seed=", 7) == 0) {
+            seed = strtoull(argv[i] + 7, NULL, 10);
+        } else if (strcmp(argv[i], "--csv") == 0) {
+            csv = 1;
+        } else {
+            ok = 0;
+        }
+        if (!ok) {
+            print_help(argv[0]);
+            return 1;
+        }
+    }
+    int matched = 0;
+    for (size_t k = 0; k < KERNELS_COUNT; ++k)
+        matched += kernel_selected(selected, kernels[k].name);
+    if (!matched) {
+        fprintf(stderr, "No such kernel in %s, see --list\n", selected);
+        return 1;
+    }
+
+    if (csv)
+        printf("kernel,params,iterations,ns_per_op,min_ns_per_op,bytes_per_op,bytes_per_ns\n");
+    else
+        printf("%-26s %-12s %12s %14s %14s %12s %8s\n", "kernel", "params", "iterations", "ns/op", "min ns/op",
+               "bytes/op", "GB/s");
+    for (size_t k = 0; k < KERNELS_COUNT; ++k) {
+        const Kernel* kernel = &kernels[k];
+        if (!kernel_selected(selected, kernel->name))
+            continue;
+        int cases = kernel->axis == BENCH_PER_FRAME ? sizes_count
+                  : (kernel->axis == BENCH_PER_COUNT ? counts_count : 1);
+        for (int i = 0; i < cases; ++i) {
+            BenchCase c;
+            memset(&c, 0, sizeof(BenchCase));
+            c.frame_size = sizes[kernel->axis == BENCH_PER_FRAME ? i : 0];
+            c.count = counts[kernel->axis == BENCH_PER_COUNT ? i : 0];
+            c.box = box;
+            c.patch = patch;
+            c.ksize = ksize;
+            c.iou_threshold = iou;
+            c.rng = seed * 0x9E3779B97F4A7C15ULL + 1;
+            run_case(kernel, &c, min_time_ms, csv);
+        }
+    }
+    return 0;
+}
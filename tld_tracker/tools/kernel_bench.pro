@@ -0,0 +1,28 @@
+QT -= gui
+
+CONFIG -= app_bundle
+CONFIG += console
+
+TARGET = kernel_bench
+
+INCLUDEPATH += .. ../tracker
+
+# Optimized even in debug configurations: the numbers are only meaningful with -O2
+QMAKE_CFLAGS += -O2
+
+SOURCES += \
+    kernel_bench.c \
+    ../tracker/fern.c \
+    ../tracker/fern_fext.c \
+    ../tracker/image_filter.c \
+    ../tracker/scanning_grid.c \
+    ../tracker/tld_utils.c
+
+HEADERS += \
+    ../tracker/fern_fext.h \
+    ../tracker/image_filter.h \
+    ../tracker/object_classifier.h \
+    ../tracker/scanning_grid.h \
+    ../tracker/tld_utils.h
+
+LIBS += -lm
@@ -0,0 +1,146 @@
+// Converts a binary results log (results_log.h) to CSV, one row per frame with
+// the proposal counts, or to JSON with the proposal lists
+#include "results_log.h"
+#include "json_output.h"
+#include <stdio.h>
+#include <string.h>
+
+static ResultsLogReader reader;
+
+static void print_help(const char* prog) {
+    printf("Usage: %s LOG [--format=csv|json] [--output=PATH]\n", prog);
+}
+
+static void json_candidate(FILE* out, const Candidate* c) {
+    fprintf(out, "{\"x\":%d,\"y\":%d,\"width\":%d,\"height\":%d,\"prob\":%.6g,\"aux_prob\":%.6g,\"valid\":%d,\"src\":%d}",
+            c->strobe.x, c->strobe.y, c->strobe.width, c->strobe.height, c->prob, c->aux_prob, c->valid, c->src);
+}
+
+static void json_candidates(FILE* out, const Candidate* c, int count) {
+    fputc('[', out);
+    for (int i = 0; i < count; ++i) {
+        if (i)
+            fputc(',', out);
+        json_candidate(out, &c[i]);
+    }
+    fputc(']', out);
+}
+
+static void json_frame(FILE* out, const ResultsLogFrame* f) {
+    const TldStatus* st = &f->status;
+    fprintf(out, "{\"frame\":%llu,\"timestamp_us\":%lld,\"prediction\":",
+            (unsigned long long)f->frame_id, (long long)f->timestamp_us);
+    json_candidate(out, &f->prediction);
+    fprintf(out, ",\"status\":{\"training\":%d,\"processing\":%d,\"fast_path\":%d,\"valid_object\":%d,"
+                 "\"tracker_relocation\":%d,\"training_skipped_cnt\":%d,\"detector_candidates_cnt\":%d,"
+                 "\"detector_clusters_cnt\":%d,\"active_ferns_cnt\":%d,\"message\":",
+            st->training, st->processing, st->fast_path, st->valid_object, st->tracker_relocation,
+            st->training_skipped_cnt, st->detector_candidates_cnt, st->detector_clusters_cnt,
+            st->active_ferns_cnt);
+    json_string(out, st->message);
+    fprintf(out, "},\"tracker_proposal\":");
+    json_candidate(out, &f->tracker_proposal);
+    fprintf(out, ",\"detector_proposals\":");
+    json_candidates(out, f->proposals, f->proposals_count);
+    fprintf(out, ",\"clusters\":");
+    json_candidates(out, f->clusters, f->clusters_count);
+    fputc('}', out);
+}
+
+static void csv_header(FILE* out) {
+    fprintf(out, "frame,timestamp_us,x,y,width,height,prob,aux_prob,valid,src,"
+                 "training,processing,fast_path,valid_object,tracker_relocation,training_skipped_cnt,"
+                 "detector_candidates_cnt,detector_clusters_cnt,active_ferns_cnt,"
+                 "tracker_x,tracker_y,tracker_width,tracker_height,tracker_prob,tracker_valid,"
+                 "proposals,clusters,message\n");
+}
+
+static void csv_frame(FILE* out, const ResultsLogFrame* f) {
+    const Candidate* p = &f->prediction;
+    const Candidate* t = &f->tracker_proposal;
+    const TldStatus* st = &f->status;
+    fprintf(out, "%llu,%lld,%d,%d,%d,%d,%.6g,%.6g,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%.6g,%d,%d,%d,\"",
+            (unsigned long long)f->frame_id, (long long)f->timestamp_us,
+            p->strobe.x, p->strobe.y, p->strobe.width, p->strobe.height, p->prob, p->aux_prob, p->valid, p->src,
+            st->training, st->processing, st->fast_path, st->valid_object, st->tracker_relocation,
+            st->training_skipped_cnt, st->detector_candidates_cnt, st->detector_clusters_cnt, st->active_ferns_cnt,
+            t->strobe.x, t->strobe.y, t->strobe.width, t->strobe.height, t->prob, t->valid,
+            f->proposals_count, f->clusters_count);
+    for (const char* s = st->message; *s; ++s) {
+        if (*s == '"')
+            fputc('"', out);
+        fputc(*s, out);
+    }
+    fprintf(out, "\"\n");
+}
+
+int main(int argc, char** argv) {
+    const char* input = NULL;
+    const char* output = NULL;
+    int json = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--help") == 0) {
+            print_help(argv[0]);
+            return 0;
+        } else if (strcmp(argv[i], "--format=json") == 0) {
+            json = 1;
+        } else if (strcmp(argv[i], "--format=csv") == 0) {
+            json = 0;
+        } else if (strncmp(argv[i], "--output=", 9) == 0) {
+            output = argv[i] + 9;
+        } else if (argv[i][0] != '-' && !input) {
+            input = argv[i];
+        } else {
+            print_help(argv[0]);
+            return 1;
+        }
+    }
+    if (!input) {
+        print_help(argv[0]);
+        return 1;
+    }
+    if (!results_log_reader_open(&reader, input)) {
+        fprintf(stderr, "Not a results log: %s\n", input);
+        return 1;
+    }
+    FILE* out = output ? fopen(output, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "Cannot write %s\n", output);
+        results_log_reader_close(&reader);
+        return 1;
+    }
+
+    ResultsLogFrame frame;
+    uint64_t dropped = 0, dropped_total = 0;
+    size_t frames = 0;
+    int records = 0;
+    int type;
+    if (json)
+        fprintf(out, "[\n");
+    else
+        csv_header(out);
+    while ((type = results_log_read(&reader, &frame, &dropped)) > 0) {
+        if (type == RESULTS_LOG_DROPPED) {
+            dropped_total += dropped;
+            if (json)
+                fprintf(out, "%s{\"dropped\":%llu}", records++ ? ",\n" : "", (unsigned long long)dropped);
+            continue;
+        }
+        if (json) {
+            fprintf(out, "%s", records++ ? ",\n" : "");
+            json_frame(out, &frame);
+        } else {
+            csv_frame(out, &frame);
+        }
+        frames++;
+    }
+    if (json)
+        fprintf(out, "\n]\n");
+    if (type < 0)
+        fprintf(stderr, "Log truncated or corrupt after %zu frames\n", frames);
+    fprintf(stderr, "%zu frames, %llu dropped by the logger\n", frames, (unsigned long long)dropped_total);
+    if (output)
+        fclose(out);
+    results_log_reader_close(&reader);
+    return type < 0 ? 1 : 0;
+}
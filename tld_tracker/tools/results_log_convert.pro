@@ -0,0 +1,18 @@
+QT -= gui
+
+CONFIG -= app_bundle
+CONFIG += console
+
+TARGET = results_log_convert
+
+INCLUDEPATH += .. ../tracker
+
+SOURCES += \
+    results_log_convert.c \
+    ../results_log.c
+
+HEADERS += \
+    ../json_output.h \
+    ../results_log.h
+
+LIBS += -lpthread
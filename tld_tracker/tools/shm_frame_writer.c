@@ -0,0 +1,137 @@
+// Stand-in for the capture process: publishes frames into a shared-memory
+// frame ring for the tracker to read with frame_source_open_shm
+// (--videopath=shm:NAME). Frames come from any mapped frame source, a
+// generated sequence (synth:SPEC, see synthetic_sequence.h) by default.
+#include "frame_source.h"
+#include "shm_frame_ring.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+static int64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void sleep_us(int64_t us) {
+    if (us <= 0)
+        return;
+    struct timespec ts = { (time_t)(us / 1000000), (long)(us % 1000000) * 1000 };
+    nanosleep(&ts, NULL);
+}
+
+static void print_help(const char* prog) {
+    printf("Usage: %s [options]\n", prog);
+    printf("  --name=NAME     shared-memory object name (default: /tld_frames)\n");
+    printf("  --input=PATH    frames to publish: *.y4m, a PGM pattern, raw GRAY8 with --rawsize\n");
+    printf("                  or synth:SPEC (default: synth:640x480,frames=300)\n");
+    printf("  --rawsize=WxH   frame size of a raw input\n");
+    printf("  --fps=F         publishing rate, 0 for as fast as possible (default: 30)\n");
+    printf("  --slots=N       ring slots (default: 8)\n");
+    printf("  --block         retry a frame while the reader holds its slot instead of dropping it\n");
+    printf("  --wait-reader   start publishing once a reader is attached\n");
+}
+
+int main(int argc, char** argv) {
+    const char* name = "/tld_frames";
+    const char* input = "synth:640x480,frames=300";
+    int raw_width = 0, raw_height = 0;
+    double fps = 30.0;
+    int slots = 8;
+    int block = 0, wait_reader = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--help") == 0) {
+            print_help(argv[0]);
+            return 0;
+        } else if (strncmp(argv[i], "--name=", 7) == 0) {
+            name = argv[i] + 7;
+        } else if (strncmp(argv[i], "--input=", 8) == 0) {
+            input = argv[i] + 8;
+        } else if (strncmp(argv[i], "--rawsize=", 10) == 0) {
+            sscanf(argv[i] + 10, "%dx%d", &raw_width, &raw_height);
+        } else if (strncmp(argv[i], "--fps=", 6) == 0) {
+            fps = atof(argv[i] + 6);
+        } else if (strncmp(argv[i], "--slots=", 8) == 0) {
+            slots = atoi(argv[i] + 8);
+        } else if (strcmp(argv[i], "--block") == 0) {
+            block = 1;
+        } else if (strcmp(argv[i], "--wait-reader") == 0) {
+            wait_reader = 1;
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            print_help(argv[0]);
+            return 1;
+        }
+    }
+
+    FrameSource* source = frame_source_open(input, raw_width, raw_height);
+    if (!source) {
+        fprintf(stderr, "Cannot open input %s\n", input);
+        return 1;
+    }
+    int width = source->width;
+    int height = source->height;
+
+    ShmFrameRing ring;
+    if (!shm_frame_ring_create(&ring, name, width, height, slots)) {
+        fprintf(stderr, "Cannot create shared-memory ring %s (already exists, or bad size or slot count)\n", name);
+        frame_source_close(source);
+        return 1;
+    }
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    if (wait_reader) {
+        printf("Waiting for a reader on %s\n", name);
+        while (!stop_requested && !atomic_load(&ring.header->reader_attached))
+            sleep_us(1000);
+    }
+
+    int64_t period_us = fps > 0.0 ? (int64_t)(1000000.0 / fps) : 0;
+    int64_t next_us = now_us();
+    size_t published = 0;
+    while (!stop_requested) {
+        Image frame;
+        if (frame_source_next(source, &frame) != 1)
+            break;
+        int64_t timestamp_us = now_us();
+        uint8_t* dst = shm_frame_ring_begin_write(&ring);
+        while (!dst && block && !stop_requested) {
+            sleep_us(200);
+            dst = shm_frame_ring_begin_write(&ring);
+        }
+        if (dst) {
+            int stride = (int)ring.header->stride;
+            for (int y = 0; y < height; ++y)
+                memcpy(dst + (size_t)y * stride, image_row(&frame, y), (size_t)width);
+            shm_frame_ring_commit(&ring, timestamp_us);
+            published++;
+        } else {
+            shm_frame_ring_drop(&ring);
+        }
+        if (period_us > 0) {
+            next_us += period_us;
+            sleep_us(next_us - now_us());
+        }
+    }
+
+    shm_frame_ring_finish(&ring);
+    printf("Published %zu frames, dropped %llu\n", published,
+           (unsigned long long)atomic_load(&ring.header->dropped));
+    // Only the name goes away: an attached reader keeps its mapping until it
+    // has read the remaining frames
+    shm_frame_ring_close(&ring);
+    frame_source_close(source);
+    return 0;
+}
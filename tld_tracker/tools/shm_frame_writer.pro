@@ -0,0 +1,22 @@
+QT -= gui
+
+CONFIG -= app_bundle
+CONFIG += console
+
+TARGET = shm_frame_writer
+
+INCLUDEPATH += .. ../tracker
+
+SOURCES += \
+    shm_frame_writer.c \
+    ../frame_source.c \
+    ../shm_frame_ring.c \
+    ../synthetic_sequence.c \
+    ../tracker/tld_utils.c
+
+HEADERS += \
+    ../frame_source.h \
+    ../shm_frame_ring.h \
+    ../synthetic_sequence.h
+
+LIBS += -lrt -lm
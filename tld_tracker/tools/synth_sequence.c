@@ -0,0 +1,126 @@
+// Writes a generated sequence to disk in the OTB layout read by tld_benchmark:
+// img/%04d.pgm (or frames.y4m), groundtruth_rect.txt with 1-based x,y,w,h per
+// frame (NaN while the target is mostly occluded) and occlusion.tag with 1
+// for every frame where the target is partly hidden.
+#include "synthetic_sequence.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+static int make_dir(const char* path) {
+    return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+
+static int write_rows(FILE* file, const Image* img) {
+    for (int y = 0; y < img->height; ++y)
+        if (fwrite(image_row(img, y), 1, (size_t)img->width, file) != (size_t)img->width)
+            return 0;
+    return 1;
+}
+
+static int write_pgm(const char* path, const Image* img) {
+    FILE* file = fopen(path, "wb");
+    if (!file)
+        return 0;
+    fprintf(file, "P5\n%d %d\n255\n", img->width, img->height);
+    int ok = write_rows(file, img);
+    return fclose(file) == 0 && ok;
+}
+
+static void print_help(const char* prog) {
+    printf("Usage: %s --output=DIR [--y4m] [SPEC]\n", prog);
+    printf("  SPEC          WxH followed by key=value pairs, comma-separated:\n");
+    printf("                frames=N seed=N fps=X object=WxH path=bounce|circle|lissajous|wander\n");
+    printf("                speed=PX scale=X rotation=DEG occlusion=PERIOD:FRAMES distractors=N\n");
+    printf("                background=flat|textured pan=X:Y noise=N\n");
+    printf("                e.g. 3840x2160,frames=600,path=circle,occlusion=150:30,distractors=2\n");
+    printf("  --output=DIR  sequence directory, created if missing\n");
+    printf("  --y4m         write DIR/frames.y4m instead of DIR/img/%%04d.pgm\n");
+}
+
+int main(int argc, char** argv) {
+    const char* output = NULL;
+    const char* spec = "";
+    int y4m = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--help") == 0) {
+            print_help(argv[0]);
+            return 0;
+        } else if (strncmp(argv[i], "--output=", 9) == 0) {
+            output = argv[i] + 9;
+        } else if (strcmp(argv[i], "--y4m") == 0) {
+            y4m = 1;
+        } else if (argv[i][0] != '-') {
+            spec = argv[i];
+        } else {
+            print_help(argv[0]);
+            return 1;
+        }
+    }
+    SyntheticSettings settings;
+    synthetic_settings_default(&settings);
+    if (!output || !synthetic_settings_parse(&settings, spec) || settings.frames == 0) {
+        fprintf(stderr, "An output directory and a finite sequence are required\n");
+        print_help(argv[0]);
+        return 1;
+    }
+    SyntheticSequence seq;
+    if (!synthetic_sequence_init(&seq, &settings)) {
+        fprintf(stderr, "The object does not fit in the frame\n");
+        return 1;
+    }
+
+    char path[4096];
+    FILE* video = NULL;
+    int ok = make_dir(output);
+    if (ok && y4m) {
+        snprintf(path, sizeof(path), "%s/frames.y4m", output);
+        video = fopen(path, "wb");
+        ok = video != NULL;
+        if (ok)
+            fprintf(video, "YUV4MPEG2 W%d H%d F%d:1000 Ip A1:1 Cmono\n", settings.width, settings.height,
+                    (int)(settings.fps * 1000.0 + 0.5));
+    } else if (ok) {
+        snprintf(path, sizeof(path), "%s/img", output);
+        ok = make_dir(path);
+    }
+    snprintf(path, sizeof(path), "%s/groundtruth_rect.txt", output);
+    FILE* truth_file = ok ? fopen(path, "w") : NULL;
+    snprintf(path, sizeof(path), "%s/occlusion.tag", output);
+    FILE* tag_file = truth_file ? fopen(path, "w") : NULL;
+    Image frame = image_create_padded(settings.width, settings.height, 0);
+    if (!tag_file || !frame.data) {
+        fprintf(stderr, "Cannot write to %s\n", output);
+        ok = 0;
+    }
+
+    for (size_t i = 0; ok && i < settings.frames; ++i) {
+        synthetic_sequence_render(&seq, i, &frame);
+        if (video) {
+            ok = fputs("FRAME\n", video) >= 0 && write_rows(video, &frame);
+        } else {
+            snprintf(path, sizeof(path), "%s/img/%04zu.pgm", output, i + 1);
+            ok = write_pgm(path, &frame);
+        }
+        SyntheticTruth truth = synthetic_sequence_truth(&seq, i);
+        if (truth.valid)
+            fprintf(truth_file, "%d,%d,%d,%d\n", truth.box.x + 1, truth.box.y + 1, truth.box.width, truth.box.height);
+        else
+            fprintf(truth_file, "NaN,NaN,NaN,NaN\n");
+        fprintf(tag_file, "%d\n", truth.occlusion > 0.0);
+        if (!ok)
+            fprintf(stderr, "Failed writing frame %zu\n", i + 1);
+    }
+
+    if (video && fclose(video) != 0)
+        ok = 0;
+    if (truth_file)
+        fclose(truth_file);
+    if (tag_file)
+        fclose(tag_file);
+    image_free(&frame);
+    synthetic_sequence_free(&seq);
+    return ok ? 0 : 1;
+}
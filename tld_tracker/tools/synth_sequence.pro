@@ -0,0 +1,21 @@
+QT -= gui
+
+CONFIG -= app_bundle
+CONFIG += console
+
+TARGET = synth_sequence
+
+INCLUDEPATH += .. ../tracker
+
+SOURCES += \
+    synth_sequence.c \
+    ../frame_source.c \
+    ../shm_frame_ring.c \
+    ../synthetic_sequence.c \
+    ../tracker/tld_utils.c
+
+HEADERS += \
+    ../frame_source.h \
+    ../synthetic_sequence.h
+
+LIBS += -lrt -lm
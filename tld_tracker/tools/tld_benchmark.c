@@ -0,0 +1,395 @@
+// Headless tracking benchmark on OTB/VOT-style sequences. Each sequence is a
+// directory with the frames and a ground-truth file, or "synth:SPEC" for a
+// generated one (see synthetic_sequence.h); the tracker starts from the first
+// box and is scored on the rest (one-pass evaluation, no restarts). Results
+// go out as JSON.
+//
+// Frames are read through the mapped frame sources, so decoding is not part
+// of the timings: convert JPEG sequences to PGM once, e.g.
+//   ffmpeg -i img/%04d.jpg -pix_fmt gray img/%04d.pgm
+#include "tld_tracker.h"
+#include "frame_source.h"
+#include "synthetic_sequence.h"
+#include "json_output.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SUCCESS_THRESHOLDS 21       // overlap thresholds 0, 0.05, ..., 1
+#define PRECISION_PIXELS 20.0
+
+typedef struct {
+    Rect* boxes;
+    int* valid;
+    size_t count;
+} GroundTruth;
+
+// Per-frame samples of one timing series
+typedef struct {
+    double* values;
+    size_t count;
+} Samples;
+
+enum { STAGE_TOTAL, STAGE_TRACK, STAGE_VERIFY, STAGE_DETECT, STAGE_INTEGRATE, STAGE_LEARN, STAGES_COUNT };
+static const char* stage_names[STAGES_COUNT] = { "total", "track", "verify", "detect", "integrate", "learn" };
+
+typedef struct {
+    int parallel;
+    int fast_path;
+    const char* frames_pattern;
+} BenchOptions;
+
+static int file_exists(const char* path) {
+    return access(path, R_OK) == 0;
+}
+
+// OTB: groundtruth_rect.txt, x,y,w,h per line, 1-based. VOT: groundtruth.txt,
+// x,y,w,h or a polygon of 4 points, 0-based. Separators may be commas, tabs or
+// spaces; lines with NaNs or empty boxes are marked invalid.
+static int ground_truth_load(const char* dir, GroundTruth* gt) {
+    char path[4096];
+    int one_based = 1;
+    snprintf(path, sizeof(path), "%s/groundtruth_rect.txt", dir);
+    if (!file_exists(path)) {
+        snprintf(path, sizeof(path), "%s/groundtruth.txt", dir);
+        one_based = 0;
+    }
+    FILE* file = fopen(path, "r");
+    if (!file)
+        return 0;
+    size_t capacity = 0;
+    char line[1024];
+    memset(gt, 0, sizeof(GroundTruth));
+    while (fgets(line, sizeof(line), file)) {
+        double v[8];
+        int n = 0;
+        char* p = line;
+        while (n < 8) {
+            while (*p == ',' || *p == '\t' || *p == ' ')
+                ++p;
+            char* end;
+            double x = strtod(p, &end);
+            if (end == p)
+                break;
+            v[n++] = x;
+            p = end;
+        }
+        if (n == 0)
+            continue;
+        if (gt->count == capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            gt->boxes = (Rect*)realloc(gt->boxes, sizeof(Rect) * capacity);
+            gt->valid = (int*)realloc(gt->valid, sizeof(int) * capacity);
+        }
+        Rect box = { 0, 0, 0, 0 };
+        int valid = 0;
+        if (n == 4 || n == 8) {
+            double x0 = v[0], y0 = v[1], x1 = v[0] + v[2], y1 = v[1] + v[3];
+            if (n == 8) {
+                x0 = x1 = v[0];
+                y0 = y1 = v[1];
+                for (int k = 2; k < 8; k += 2) {
+                    x0 = fmin(x0, v[k]);
+                    x1 = fmax(x1, v[k]);
+                    y0 = fmin(y0, v[k + 1]);
+                    y1 = fmax(y1, v[k + 1]);
+                }
+            }
+            valid = !isnan(x0) && !isnan(y0) && !isnan(x1) && !isnan(y1) && x1 - x0 >= 1.0 && y1 - y0 >= 1.0;
+            if (valid) {
+                box.x = (int)lround(x0) - one_based;
+                box.y = (int)lround(y0) - one_based;
+                box.width = (int)lround(x1 - x0);
+                box.height = (int)lround(y1 - y0);
+            }
+        }
+        gt->boxes[gt->count] = box;
+        gt->valid[gt->count] = valid;
+        gt->count++;
+    }
+    fclose(file);
+    return gt->count > 0;
+}
+
+static void ground_truth_free(GroundTruth* gt) {
+    free(gt->boxes);
+    free(gt->valid);
+    memset(gt, 0, sizeof(GroundTruth));
+}
+
+static FrameSource* open_sequence_frames(const char* dir, const BenchOptions* options) {
+    char pattern[4096];
+    if (options->frames_pattern) {
+        snprintf(pattern, sizeof(pattern), "%s/%s", dir, options->frames_pattern);
+        return frame_source_open(pattern, 0, 0);
+    }
+    static const char* layouts[] = { "img/%04d.pgm", "%08d.pgm", "color/%08d.pgm", "%04d.pgm" };
+    for (size_t i = 0; i < sizeof(layouts) / sizeof(layouts[0]); ++i) {
+        snprintf(pattern, sizeof(pattern), "%s/%s", dir, layouts[i]);
+        FrameSource* src = frame_source_open_pgm_sequence(pattern, 1);
+        if (src)
+            return src;
+    }
+    snprintf(pattern, sizeof(pattern), "%s/frames.y4m", dir);
+    return frame_source_open_y4m(pattern);
+}
+
+// Generated sequence: the ground truth comes from the generator itself
+static FrameSource* open_synthetic(const char* spec, GroundTruth* gt) {
+    SyntheticSettings settings;
+    SyntheticSequence seq;
+    synthetic_settings_default(&settings);
+    if (!synthetic_settings_parse(&settings, spec) || settings.frames == 0 ||
+        !synthetic_sequence_init(&seq, &settings))
+        return NULL;
+    gt->count = settings.frames;
+    gt->boxes = (Rect*)malloc(sizeof(Rect) * gt->count);
+    gt->valid = (int*)malloc(sizeof(int) * gt->count);
+    for (size_t i = 0; i < gt->count; ++i) {
+        SyntheticTruth truth = synthetic_sequence_truth(&seq, i);
+        gt->boxes[i] = truth.box;
+        gt->valid[i] = truth.valid;
+    }
+    synthetic_sequence_free(&seq);
+    FrameSource* source = frame_source_open_synthetic(&settings);
+    if (!source)
+        ground_truth_free(gt);
+    return source;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+// Nearest-rank percentile of sorted values
+static double percentile(const Samples* s, double p) {
+    if (s->count == 0)
+        return 0.0;
+    size_t rank = (size_t)ceil(p / 100.0 * s->count);
+    if (rank < 1) rank = 1;
+    return s->values[rank - 1];
+}
+
+static void print_samples(FILE* out, const char* name, Samples* s) {
+    qsort(s->values, s->count, sizeof(double), compare_doubles);
+    double sum = 0.0;
+    for (size_t i = 0; i < s->count; ++i)
+        sum += s->values[i];
+    fprintf(out, "\"%s\":{\"runs\":%zu,\"mean_us\":%.1f,\"p50_us\":%.1f,\"p90_us\":%.1f,\"p99_us\":%.1f,\"max_us\":%.1f}",
+            name, s->count, s->count ? sum / s->count : 0.0, percentile(s, 50), percentile(s, 90),
+            percentile(s, 99), s->count ? s->values[s->count - 1] : 0.0);
+}
+
+typedef struct {
+    double fps;
+    double mean_iou;
+    double success_auc;
+    double precision;
+    int failures;
+    size_t frames;
+} SequenceScore;
+
+// Writes the sequence report after separator; returns 0 if the sequence could not be read
+static int run_sequence(FILE* out, const char* separator, const char* dir, const BenchOptions* options,
+                        SequenceScore* score) {
+    GroundTruth gt;
+    FrameSource* source;
+    if (strncmp(dir, "synth:", 6) == 0) {
+        source = open_synthetic(dir + 6, &gt);
+        if (!source) {
+            fprintf(stderr, "%s: bad synthetic sequence (a frame count is required)\n", dir);
+            return 0;
+        }
+    } else if (!ground_truth_load(dir, &gt)) {
+        fprintf(stderr, "%s: no ground truth\n", dir);
+        return 0;
+    } else if (!(source = open_sequence_frames(dir, options))) {
+        fprintf(stderr, "%s: no frames (PGM sequence or frames.y4m expected)\n", dir);
+        ground_truth_free(&gt);
+        return 0;
+    }
+
+    TldTracker tracker;
+    tld_tracker_init(&tracker, default_settings());
+    tld_tracker_set_parallel(&tracker, options->parallel);
+    if (options->fast_path)
+        tld_tracker_set_fast_path(&tracker, 1, 10, 5);
+
+    Samples stages[STAGES_COUNT];
+    for (int k = 0; k < STAGES_COUNT; ++k) {
+        stages[k].values = (double*)malloc(sizeof(double) * gt.count);
+        stages[k].count = 0;
+    }
+    size_t success[SUCCESS_THRESHOLDS] = { 0 };
+    size_t scored = 0, precise = 0;
+    double iou_sum = 0.0, total_us = 0.0;
+    int failures = 0, lost = 0;
+
+    Image frame;
+    size_t index = 0;
+    while (index < gt.count && frame_source_next(source, &frame) == 1) {
+        Candidate result = tld_tracker_process_frame_borrowed(&tracker, &frame);
+        TldStageTimes t = tld_tracker_get_stage_times(&tracker);
+        if (index == 0) {
+            // The first box starts tracking and is not scored
+            tld_tracker_start_tracking(&tracker, gt.boxes[0]);
+            index++;
+            continue;
+        }
+        double times[STAGES_COUNT] = { t.total_us, t.track_us, t.verify_us, t.detect_us, t.integrate_us, t.learn_us };
+        for (int k = 0; k < STAGES_COUNT; ++k)
+            if (k == STAGE_TOTAL || times[k] > 0.0)
+                stages[k].values[stages[k].count++] = times[k];
+        total_us += t.total_us;
+
+        if (gt.valid[index]) {
+            Rect truth = gt.boxes[index];
+            double iou = result.valid ? compute_iou(result.strobe, truth) : 0.0;
+            iou_sum += iou;
+            for (int k = 0; k < SUCCESS_THRESHOLDS; ++k)
+                if (iou > (double)k / (SUCCESS_THRESHOLDS - 1))
+                    success[k]++;
+            if (result.valid) {
+                double dx = (result.strobe.x + result.strobe.width * 0.5) - (truth.x + truth.width * 0.5);
+                double dy = (result.strobe.y + result.strobe.height * 0.5) - (truth.y + truth.height * 0.5);
+                if (sqrt(dx * dx + dy * dy) <= PRECISION_PIXELS)
+                    precise++;
+            }
+            // A failure is the target being lost: overlap drops to zero
+            if (iou == 0.0 && !lost)
+                failures++;
+            lost = iou == 0.0;
+            scored++;
+        }
+        index++;
+    }
+
+    double auc = 0.0;
+    for (int k = 0; k < SUCCESS_THRESHOLDS; ++k)
+        auc += scored ? (double)success[k] / scored : 0.0;
+    auc /= SUCCESS_THRESHOLDS;
+    size_t frames = stages[STAGE_TOTAL].count;
+    score->fps = total_us > 0.0 ? frames * 1e6 / total_us : 0.0;
+    score->mean_iou = scored ? iou_sum / scored : 0.0;
+    score->success_auc = auc;
+    score->precision = scored ? (double)precise / scored : 0.0;
+    score->failures = failures;
+    score->frames = frames;
+
+    const char* name = strrchr(dir, '/');
+    name = name && name[1] ? name + 1 : dir;
+    fprintf(out, "%s{\"sequence\":", separator);
+    json_string(out, name);
+    fprintf(out, ",\"frames\":%zu,\"scored_frames\":%zu,\"fps\":%.2f,\"mean_iou\":%.4f,\"success_auc\":%.4f,"
+                 "\"precision_20px\":%.4f,\"failures\":%d,\"latency\":{",
+            frames, scored, score->fps, score->mean_iou, score->success_auc, score->precision, failures);
+    for (int k = 0; k < STAGES_COUNT; ++k) {
+        if (k)
+            fputc(',', out);
+        print_samples(out, stage_names[k], &stages[k]);
+        free(stages[k].values);
+    }
+    fprintf(out, "}}");
+
+    tld_tracker_free(&tracker);
+    frame_source_close(source);
+    ground_truth_free(&gt);
+    return 1;
+}
+
+static void print_help(const char* prog) {
+    printf("Usage: %s [options] SEQUENCE_DIR|synth:SPEC...\n", prog);
+    printf("  --list=FILE       read sequence directories from FILE, one per line\n");
+    printf("  --frames=PATTERN  frame pattern inside each directory (default: img/%%04d.pgm,\n");
+    printf("                    %%08d.pgm, color/%%08d.pgm, %%04d.pgm or frames.y4m)\n");
+    printf("  --output=PATH     JSON report (default: stdout)\n");
+    printf("  --parallel        detect and track on two threads\n");
+    printf("  --fast-path       enable the tracker-only fast path\n");
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options = { 0, 0, NULL };
+    const char* output = NULL;
+    const char* list = NULL;
+    char** dirs = (char**)malloc(sizeof(char*) * (size_t)argc);
+    size_t dirs_count = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--help") == 0) {
+            print_help(argv[0]);
+            free(dirs);
+            return 0;
+        } else if (strncmp(argv[i], "--list=", 7) == 0) {
+            list = argv[i] + 7;
+        } else if (strncmp(argv[i], "--frames=", 9) == 0) {
+            options.frames_pattern = argv[i] + 9;
+        } else if (strncmp(argv[i], "--output=", 9) == 0) {
+            output = argv[i] + 9;
+        } else if (strcmp(argv[i], "--parallel") == 0) {
+            options.parallel = 1;
+        } else if (strcmp(argv[i], "--fast-path") == 0) {
+            options.fast_path = 1;
+        } else if (argv[i][0] != '-') {
+            dirs[dirs_count++] = strdup(argv[i]);
+        } else {
+            print_help(argv[0]);
+            free(dirs);
+            return 1;
+        }
+    }
+    if (list) {
+        FILE* file = fopen(list, "r");
+        char line[4096];
+        while (file && fgets(line, sizeof(line), file)) {
+            line[strcspn(line, "\r\n")] = '\0';
+            if (line[0] == '\0' || line[0] == '#')
+                continue;
+            dirs = (char**)realloc(dirs, sizeof(char*) * (dirs_count + 1));
+            dirs[dirs_count++] = strdup(line);
+        }
+        if (file)
+            fclose(file);
+        else
+            fprintf(stderr, "Cannot read %s\n", list);
+    }
+    if (dirs_count == 0) {
+        print_help(argv[0]);
+        free(dirs);
+        return 1;
+    }
+
+    FILE* out = output ? fopen(output, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "Cannot write %s\n", output);
+        return 1;
+    }
+    fprintf(out, "{\"parallel\":%d,\"fast_path\":%d,\"sequences\":[\n", options.parallel, options.fast_path);
+    SequenceScore sum = { 0.0, 0.0, 0.0, 0.0, 0, 0 };
+    size_t done = 0;
+    for (size_t i = 0; i < dirs_count; ++i) {
+        SequenceScore score;
+        if (run_sequence(out, done ? ",\n" : "", dirs[i], &options, &score)) {
+            sum.fps += score.fps;
+            sum.mean_iou += score.mean_iou;
+            sum.success_auc += score.success_auc;
+            sum.precision += score.precision;
+            sum.failures += score.failures;
+            sum.frames += score.frames;
+            done++;
+        }
+        free(dirs[i]);
+    }
+    free(dirs);
+    // Averages over sequences, as OTB reports them
+    double n = done ? (double)done : 1.0;
+    fprintf(out, "\n],\"summary\":{\"sequences\":%zu,\"frames\":%zu,\"mean_fps\":%.2f,\"mean_iou\":%.4f,"
+                 "\"success_auc\":%.4f,\"precision_20px\":%.4f,\"failures\":%d}}\n",
+            done, sum.frames, sum.fps / n, sum.mean_iou / n, sum.success_auc / n, sum.precision / n, sum.failures);
+    if (output)
+        fclose(out);
+    return done == dirs_count ? 0 : 1;
+}
@@ -0,0 +1,37 @@
+QT -= gui
+
+CONFIG -= app_bundle
+CONFIG += console
+
+TARGET = tld_benchmark
+
+INCLUDEPATH += .. ../tracker
+
+SOURCES += \
+    tld_benchmark.c \
+    ../frame_source.c \
+    ../shm_frame_ring.c \
+    ../synthetic_sequence.c \
+    ../tracker/augmentator.c \
+    ../tracker/fern.c \
+    ../tracker/fern_fext.c \
+    ../tracker/frame_cache.c \
+    ../tracker/frame_ring.c \
+    ../tracker/image_filter.c \
+    ../tracker/integrator.c \
+    ../tracker/object_detector.c \
+    ../tracker/object_model.c \
+    ../tracker/opt_flow_tracker.c \
+    ../tracker/pyr_lk.c \
+    ../tracker/scanning_grid.c \
+    ../tracker/tld_tracker.c \
+    ../tracker/tld_utils.c
+
+HEADERS += \
+    ../frame_source.h \
+    ../json_output.h \
+    ../shm_frame_ring.h \
+    ../synthetic_sequence.h \
+    ../tracker/tld_tracker.h
+
+LIBS += -lpthread -lrt -lm
@@ -18,6 +18,7 @@ void Augmentator_init(Augmentator* aug, const Image* frame, Rect target, Transfo
     aug->_sample = NULL;
     aug->_sample_count = 0;
     aug->_target_stddev = 0.0;
+    aug->_integral = NULL;
 
     aug->SetClass = Augmentator_SetClass;
     aug->make_positive_sample = augmentator_make_positive_sample;
@@ -27,6 +28,18 @@ void Augmentator_init(Augmentator* aug, const Image* frame, Rect target, Transfo
     aug->end = augmentator_sample_end;
 }
 
+void augmentator_set_integral(Augmentator* aug, const IntegralImage* integral) {
+    if (integral && (integral->width != aug->_frame.width || integral->height != aug->_frame.height))
+        integral = NULL;
+    aug->_integral = integral;
+}
+
+static double augmentator_std_dev(const Augmentator* aug, Rect roi) {
+    if (aug->_integral)
+        return integral_image_std_dev(aug->_integral, roi);
+    return get_frame_std_dev(&aug->_frame, roi);
+}
+
 Augmentator* Augmentator_SetClass(Augmentator* aug, ObjectClass name) {
     if (name == OBJECT_CLASS_POSITIVE) {
         augmentator_make_positive_sample(aug);
@@ -125,7 +138,7 @@ void augmentator_make_negative_sample(Augmentator* aug) {
                 current_rect.x = x_org * step_x;
                 current_rect.y = y_org * step_y;
                 double iou = compute_iou(current_rect, aug->_target);
-                double stddev = get_frame_std_dev(&aug->_frame, current_rect);
+                double stddev = augmentator_std_dev(aug, current_rect);
                 if ((iou < 0.1) && (stddev > target_stddev * aug->_pars.disp_threshold)) {
                     Image neg = image_subframe_clone(&aug->_frame, current_rect);
                     aug->_sample = realloc(aug->_sample, sizeof(Image) * (aug->_sample_count + 1));
@@ -146,7 +159,7 @@ double augmentator_update_target_stddev(Augmentator* aug) {
     int target_outside_frame = strobe_is_outside(aug->_target, image_size(&aug->_frame));
     if (target_outside_frame)
         return aug->_target_stddev;
-    aug->_target_stddev = get_frame_std_dev(&aug->_frame, aug->_target);
+    aug->_target_stddev = augmentator_std_dev(aug, aug->_target);
     return aug->_target_stddev;
 }
 
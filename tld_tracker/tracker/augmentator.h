@@ -3,6 +3,7 @@
 
 #include "common.h"
 #include "tld_utils.h"
+#include "image_filter.h"
 
 // ---- ENUMS AND STRUCTS ----
 
@@ -31,6 +32,7 @@ typedef struct Augmentator {
     Rect _target;
     TransformPars _pars;
     double _target_stddev;
+    const IntegralImage* _integral; // of _frame, optional: O(1) stddev per box
     Image* _sample;
     int _sample_count;
 } Augmentator;
@@ -42,6 +44,7 @@ Augmentator* Augmentator_SetClass(Augmentator* aug, ObjectClass name);
 void augmentator_make_positive_sample(Augmentator* aug);
 void augmentator_make_negative_sample(Augmentator* aug);
 double augmentator_update_target_stddev(Augmentator* aug);
+void augmentator_set_integral(Augmentator* aug, const IntegralImage* integral);
 Image* augmentator_sample_begin(Augmentator* aug);
 Image* augmentator_sample_end(Augmentator* aug);
 void augmentator_free(Augmentator* aug);
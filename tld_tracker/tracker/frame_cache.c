@@ -0,0 +1,61 @@
+#include "frame_cache.h"
+#include <string.h>
+
+void frame_cache_init(FrameCache* cache, int lf_ksize, int border) {
+    memset(cache, 0, sizeof(FrameCache));
+    cache->lf_ksize = lf_ksize;
+    cache->border = border;
+}
+
+// Padded buffer for the low-frequency frame, reallocated on size changes only
+static void frame_cache_reserve_lf(FrameCache* cache) {
+    Image* lf = &cache->lf_frame;
+    if (lf->data && lf->width == cache->frame->width && lf->height == cache->frame->height &&
+        lf->border == cache->border)
+        return;
+    image_free(lf);
+    *lf = image_create_padded(cache->frame->width, cache->frame->height, cache->border);
+}
+
+void frame_cache_free(FrameCache* cache) {
+    image_free(&cache->lf_frame);
+    integral_image_free(&cache->lf_integral);
+    box_filter_scratch_free(&cache->blur_scratch);
+    cache->frame = NULL;
+    cache->lf_ready = 0;
+    cache->lf_integral_ready = 0;
+}
+
+void frame_cache_set_frame(FrameCache* cache, Image* frame) {
+    cache->frame = frame;
+    cache->lf_ready = 0;
+    cache->lf_integral_ready = 0;
+}
+
+// Low-frequency frame for the detector
+Image* frame_cache_lf_frame(FrameCache* cache) {
+    if (!cache->lf_ready && cache->frame) {
+        IntegralImage* integral = cache->lf_integral_wanted ? &cache->lf_integral : NULL;
+        frame_cache_reserve_lf(cache);
+        box_filter(cache->frame, &cache->lf_frame, cache->lf_ksize, integral, &cache->blur_scratch);
+        cache->lf_ready = 1;
+        cache->lf_integral_ready = (integral != NULL);
+    }
+    return &cache->lf_frame;
+}
+
+// Integral images of the low-frequency frame, for stddev checks of many boxes
+const IntegralImage* frame_cache_lf_integral(FrameCache* cache) {
+    cache->lf_integral_wanted = 1;
+    if (!cache->lf_integral_ready && cache->frame) {
+        if (cache->lf_ready) {
+            integral_image_build(&cache->lf_frame, &cache->lf_integral);
+        } else {
+            frame_cache_reserve_lf(cache);
+            box_filter(cache->frame, &cache->lf_frame, cache->lf_ksize, &cache->lf_integral, &cache->blur_scratch);
+            cache->lf_ready = 1;
+        }
+        cache->lf_integral_ready = 1;
+    }
+    return &cache->lf_integral;
+}
@@ -0,0 +1,30 @@
+#ifndef FRAME_CACHE_H
+#define FRAME_CACHE_H
+
+#include "tld_utils.h"
+#include "image_filter.h"
+
+// Per-frame derivatives of the source frame, each computed on the first request
+// in a frame and shared by every later consumer. set_frame is O(1), so a frame
+// nobody asks anything of costs nothing.
+typedef struct {
+    Image* frame;           // current source frame, not owned
+    int lf_ksize;
+    int border;             // replicated border of lf_frame
+    Image lf_frame;
+    IntegralImage lf_integral;
+    BoxFilterScratch blur_scratch;
+    int lf_ready;
+    int lf_integral_ready;
+    // Once the integral has been asked for, it is produced together with the
+    // blur in later frames instead of by a separate pass
+    int lf_integral_wanted;
+} FrameCache;
+
+void frame_cache_init(FrameCache* cache, int lf_ksize, int border);
+void frame_cache_free(FrameCache* cache);
+void frame_cache_set_frame(FrameCache* cache, Image* frame);
+Image* frame_cache_lf_frame(FrameCache* cache);
+const IntegralImage* frame_cache_lf_integral(FrameCache* cache);
+
+#endif
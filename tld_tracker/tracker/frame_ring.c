@@ -0,0 +1,61 @@
+#include "frame_ring.h"
+#include <stdlib.h>
+#include <string.h>
+
+void frame_ring_init(FrameRing* ring, int border) {
+    memset(ring, 0, sizeof(FrameRing));
+    ring->border = border;
+}
+
+void frame_ring_free(FrameRing* ring) {
+    for (int i = 0; i < FRAME_RING_SIZE; ++i)
+        image_free(&ring->slots[i].storage);
+    frame_ring_init(ring, ring->border);
+}
+
+// Round robin over the free slots, so a released frame is not reused right away
+static FrameBuffer* frame_ring_take(FrameRing* ring) {
+    for (int k = 0; k < FRAME_RING_SIZE; ++k) {
+        FrameBuffer* buf = &ring->slots[(ring->next + k) % FRAME_RING_SIZE];
+        if (buf->refs == 0) {
+            ring->next = (ring->next + k + 1) % FRAME_RING_SIZE;
+            buf->refs = 1;
+            return buf;
+        }
+    }
+    return NULL;
+}
+
+FrameBuffer* frame_ring_acquire(FrameRing* ring, int width, int height) {
+    FrameBuffer* buf = frame_ring_take(ring);
+    if (!buf)
+        return NULL;
+    Image* storage = &buf->storage;
+    if (!storage->data || storage->width != width || storage->height != height ||
+        storage->border != ring->border) {
+        image_free(storage);
+        *storage = image_create_padded(width, height, ring->border);
+        if (!storage->data) {
+            buf->refs = 0;
+            return NULL;
+        }
+    }
+    buf->img = *storage;
+    return buf;
+}
+
+FrameBuffer* frame_ring_wrap(FrameRing* ring, const Image* frame) {
+    FrameBuffer* buf = frame_ring_take(ring);
+    if (buf)
+        buf->img = *frame;
+    return buf;
+}
+
+void frame_buffer_retain(FrameBuffer* buf) {
+    buf->refs++;
+}
+
+void frame_buffer_release(FrameBuffer* buf) {
+    if (buf && buf->refs > 0)
+        buf->refs--;
+}
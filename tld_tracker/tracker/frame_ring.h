@@ -0,0 +1,34 @@
+#ifndef FRAME_RING_H
+#define FRAME_RING_H
+
+#include "tld_utils.h"
+#include <stddef.h>
+
+// Current and previous frame, one being filled by the caller, one spare
+#define FRAME_RING_SIZE 4
+
+// Reference-counted frame. img either refers to storage (an aligned image with
+// the ring's border, kept between uses, so a ring cycling frames of one size
+// allocates only on the first pass) or to memory borrowed from the caller.
+typedef struct {
+    Image img;
+    Image storage;
+    int refs;
+} FrameBuffer;
+
+typedef struct {
+    FrameBuffer slots[FRAME_RING_SIZE];
+    int next;
+    int border;
+} FrameRing;
+
+void frame_ring_init(FrameRing* ring, int border);
+void frame_ring_free(FrameRing* ring);
+// Both return a buffer holding one reference, or NULL if every slot is in use
+FrameBuffer* frame_ring_acquire(FrameRing* ring, int width, int height);
+FrameBuffer* frame_ring_wrap(FrameRing* ring, const Image* frame);
+
+void frame_buffer_retain(FrameBuffer* buf);
+void frame_buffer_release(FrameBuffer* buf);
+
+#endif
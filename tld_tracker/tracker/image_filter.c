@@ -0,0 +1,193 @@
+#include "image_filter.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Normalization by a fixed-point reciprocal of the kernel area. With 40 bits
+// the product is exact floor division for every sum below 2^24, which covers
+// 255 * 255^2 plus the rounding term, so the output is the rounded box mean.
+#define BOX_INV_BITS 40
+
+static inline int clamp_index(int i, int size) {
+    return i < 0 ? 0 : (i >= size ? size - 1 : i);
+}
+
+// Reallocation keeps the border dst was created with
+static void image_reserve(Image* img, int width, int height) {
+    if (img->data && img->width == width && img->height == height)
+        return;
+    int border = img->data ? img->border : 0;
+    image_free(img);
+    *img = image_create_padded(width, height, border);
+}
+
+static void integral_image_reserve(IntegralImage* integral, int width, int height) {
+    if (integral->sum && integral->width == width && integral->height == height)
+        return;
+    free(integral->sum);
+    free(integral->sqsum);
+    size_t size = (size_t)(width + 1) * (height + 1);
+    integral->width = width;
+    integral->height = height;
+    integral->sum = (uint32_t*)malloc(sizeof(uint32_t) * size);
+    integral->sqsum = (uint64_t*)malloc(sizeof(uint64_t) * size);
+    memset(integral->sum, 0, sizeof(uint32_t) * (width + 1));
+    memset(integral->sqsum, 0, sizeof(uint64_t) * (width + 1));
+}
+
+// Integral row y+1 from row y and image row y
+static void integral_row(IntegralImage* integral, const uint8_t* row, int y) {
+    int stride = integral->width + 1;
+    const uint32_t* sum_prev = integral->sum + (size_t)y * stride;
+    const uint64_t* sq_prev = integral->sqsum + (size_t)y * stride;
+    uint32_t* sum = integral->sum + (size_t)(y + 1) * stride;
+    uint64_t* sq = integral->sqsum + (size_t)(y + 1) * stride;
+    uint32_t row_sum = 0;
+    uint64_t row_sq = 0;
+    sum[0] = 0;
+    sq[0] = 0;
+    for (int x = 0; x < integral->width; ++x) {
+        uint32_t v = row[x];
+        row_sum += v;
+        row_sq += v * v;
+        sum[x + 1] = sum_prev[x + 1] + row_sum;
+        sq[x + 1] = sq_prev[x + 1] + row_sq;
+    }
+}
+
+// colsum[x] += add[x] - sub[x]
+static void colsum_update(uint16_t* colsum, const uint8_t* add, const uint8_t* sub, int width) {
+    int x = 0;
+#if defined(__SSE2__)
+    __m128i z = _mm_setzero_si128();
+    for (; x <= width - 16; x += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(add + x));
+        __m128i s = _mm_loadu_si128((const __m128i*)(sub + x));
+        __m128i c0 = _mm_loadu_si128((const __m128i*)(colsum + x));
+        __m128i c1 = _mm_loadu_si128((const __m128i*)(colsum + x + 8));
+        c0 = _mm_sub_epi16(_mm_add_epi16(c0, _mm_unpacklo_epi8(a, z)), _mm_unpacklo_epi8(s, z));
+        c1 = _mm_sub_epi16(_mm_add_epi16(c1, _mm_unpackhi_epi8(a, z)), _mm_unpackhi_epi8(s, z));
+        _mm_storeu_si128((__m128i*)(colsum + x), c0);
+        _mm_storeu_si128((__m128i*)(colsum + x + 8), c1);
+    }
+#endif
+    for (; x < width; ++x)
+        colsum[x] = (uint16_t)(colsum[x] + add[x] - sub[x]);
+}
+
+// Horizontal running sum over column sums padded by ksize/2 on both sides
+static void box_row(const uint16_t* colsum, uint8_t* out, int width, int ksize, uint64_t inv) {
+    // The area is odd, so there are no ties to round
+    const uint32_t half = (uint32_t)(ksize * ksize) / 2;
+    uint32_t s = half;
+    for (int k = 0; k < ksize; ++k)
+        s += colsum[k];
+    out[0] = (uint8_t)((s * inv) >> BOX_INV_BITS);
+    for (int x = 1; x < width; ++x) {
+        s += colsum[x + ksize - 1] - colsum[x - 1];
+        out[x] = (uint8_t)((s * inv) >> BOX_INV_BITS);
+    }
+}
+
+// Separable box filter with running sums in both directions. Each output row
+// costs one vector update of the column sums (the incoming row added, the
+// outgoing one subtracted) and one horizontal scan, independently of ksize;
+// only ksize source rows and a row of column sums are live at a time.
+void box_filter(const Image* src, Image* dst, int ksize, IntegralImage* integral, BoxFilterScratch* scratch) {
+    int w = src->width, h = src->height;
+    if (ksize < 1) ksize = 1;
+    if (ksize > BOX_MAX_KSIZE) ksize = BOX_MAX_KSIZE;
+    ksize |= 1;
+    int r = ksize / 2;
+    uint64_t area = (uint64_t)ksize * ksize;
+    uint64_t inv = ((1ull << BOX_INV_BITS) + area - 1) / area;
+
+    image_reserve(dst, w, h);
+    if (integral)
+        integral_image_reserve(integral, w, h);
+    if (w <= 0 || h <= 0)
+        return;
+
+    size_t need = (size_t)w + 2 * r;
+    if (scratch->capacity < need) {
+        free(scratch->colsum);
+        scratch->colsum = (uint16_t*)malloc(sizeof(uint16_t) * need);
+        scratch->capacity = need;
+    }
+    uint16_t* colsum = scratch->colsum;
+    uint16_t* inner = colsum + r;
+
+    memset(inner, 0, sizeof(uint16_t) * w);
+    for (int dy = -r; dy <= r; ++dy) {
+        const uint8_t* row = image_row(src, clamp_index(dy, h));
+        for (int x = 0; x < w; ++x)
+            inner[x] = (uint16_t)(inner[x] + row[x]);
+    }
+
+    for (int y = 0; y < h; ++y) {
+        for (int k = 0; k < r; ++k) {
+            colsum[k] = inner[0];
+            inner[w + k] = inner[w - 1];
+        }
+        box_row(colsum, image_row(dst, y), w, ksize, inv);
+        if (integral)
+            integral_row(integral, image_row(dst, y), y);
+        if (y + 1 < h)
+            colsum_update(inner, image_row(src, clamp_index(y + 1 + r, h)),
+                          image_row(src, clamp_index(y - r, h)), w);
+    }
+    image_replicate_border(dst);
+}
+
+void blur_image(const Image* src, Image* dst, int ksize) {
+    BoxFilterScratch scratch = { NULL, 0 };
+    box_filter(src, dst, ksize, NULL, &scratch);
+    box_filter_scratch_free(&scratch);
+}
+
+void box_filter_scratch_free(BoxFilterScratch* scratch) {
+    free(scratch->colsum);
+    scratch->colsum = NULL;
+    scratch->capacity = 0;
+}
+
+void integral_image_build(const Image* src, IntegralImage* integral) {
+    integral_image_reserve(integral, src->width, src->height);
+    for (int y = 0; y < src->height; ++y)
+        integral_row(integral, image_row(src, y), y);
+}
+
+// Same result as get_frame_std_dev in O(1) per ROI
+double integral_image_std_dev(const IntegralImage* integral, Rect roi) {
+    Rect r = roi;
+    if (r.x < 0) { r.width += r.x; r.x = 0; }
+    if (r.y < 0) { r.height += r.y; r.y = 0; }
+    if (r.x + r.width > integral->width) r.width = integral->width - r.x;
+    if (r.y + r.height > integral->height) r.height = integral->height - r.y;
+    if (r.width <= 0 || r.height <= 0)
+        return 0.0;
+
+    int stride = integral->width + 1;
+    size_t i00 = (size_t)r.y * stride + r.x;
+    size_t i01 = i00 + r.width;
+    size_t i10 = i00 + (size_t)r.height * stride;
+    size_t i11 = i10 + r.width;
+    double count = (double)r.width * r.height;
+    double sum = (double)(integral->sum[i11] - integral->sum[i01] - integral->sum[i10] + integral->sum[i00]);
+    double sqsum = (double)(integral->sqsum[i11] - integral->sqsum[i01] - integral->sqsum[i10] + integral->sqsum[i00]);
+    double mean = sum / count;
+    double variance = sqsum / count - mean * mean;
+    return sqrt(variance > 0.0 ? variance : 0.0);
+}
+
+void integral_image_free(IntegralImage* integral) {
+    free(integral->sum);
+    free(integral->sqsum);
+    integral->sum = NULL;
+    integral->sqsum = NULL;
+    integral->width = 0;
+    integral->height = 0;
+}
@@ -0,0 +1,36 @@
+#ifndef IMAGE_FILTER_H
+#define IMAGE_FILTER_H
+
+#include "tld_utils.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Integral images of the pixel values and their squares, (width+1) x (height+1)
+// with a zero first row and column
+typedef struct {
+    int width, height;
+    uint32_t* sum;
+    uint64_t* sqsum;
+} IntegralImage;
+
+// Rolling column sums of the box filter, kept between calls
+typedef struct {
+    uint16_t* colsum;
+    size_t capacity;
+} BoxFilterScratch;
+
+// Largest box filter kernel: its column sums of 8-bit pixels stay within 16 bits
+#define BOX_MAX_KSIZE 255
+
+// ksize x ksize box filter (ksize odd, borders replicated). dst is reallocated
+// only when its size differs from src, keeping its border, which is filled. If integral is not NULL it is filled
+// from the filtered rows while they are still in cache.
+void box_filter(const Image* src, Image* dst, int ksize, IntegralImage* integral, BoxFilterScratch* scratch);
+void blur_image(const Image* src, Image* dst, int ksize);
+void box_filter_scratch_free(BoxFilterScratch* scratch);
+
+void integral_image_build(const Image* src, IntegralImage* integral);
+double integral_image_std_dev(const IntegralImage* integral, Rect roi);
+void integral_image_free(IntegralImage* integral);
+
+#endif
@@ -1,11 +1,39 @@
 #include "integrator.h"
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+static double integrator_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec * 1e-3;
+}
 
 void integrator_init(Integrator* integrator, ObjectModel* model) {
     integrator->model = model;
+    integrator->verification_batch_size = MAX_CANDIDATES_BATCH;
+    integrator->max_verified_clusters = MAX_CANDIDATES;
+    integrator->verified_clusters_count = 0;
+    integrator->verification_us = 0.0;
+}
+
+// Helper: Descending sort by detector prob
+static int compare_candidate_prob_desc(const void* a, const void* b) {
+    double pa = ((const Candidate*)a)->prob;
+    double pb = ((const Candidate*)b)->prob;
+    return (pb > pa) - (pb < pa);
 }
+
+int compare_candidate_aux_prob_desc(const void* a, const void* b);
+
 void integrator_preprocess_candidates(Integrator* integrator) {
+    double verification_start = integrator_now_us();
+    // Tracker proposal is scored first: clusters are ranked against it below
+    integrator->tracker_raw_proposal.aux_prob = object_model_predict_candidate(
+        integrator->model, integrator->tracker_raw_proposal
+    );
+    integrator->verification_us = integrator_now_us() - verification_start;
+
     // Clusterize detector proposals
     integrator->detector_proposal_clusters_count =
         clusterize_candidates(
@@ -14,19 +42,39 @@ void integrator_preprocess_candidates(Integrator* integrator) {
             integrator->detector_proposal_clusters
         );
 
-    // Remove clusters invalidated by model
+    // Verify clusters by the model in detector probability order, one batch at a time.
+    // By default every cluster is verified. A smaller max_verified_clusters stops once
+    // that many have passed, but the decision below ranks by aux_prob, so a dropped
+    // cluster may be the one the model trusts most: the cap trades accuracy for time.
+    qsort(
+        integrator->detector_proposal_clusters,
+        integrator->detector_proposal_clusters_count,
+        sizeof(Candidate),
+        compare_candidate_prob_desc
+    );
+    verification_start = integrator_now_us();
     size_t valid_count = 0;
-    for (size_t i = 0; i < integrator->detector_proposal_clusters_count; ++i) {
-        Candidate* item = &integrator->detector_proposal_clusters[i];
-        item->aux_prob = object_model_predict(integrator->model, item);
-        if (item->aux_prob >= integrator->settings.model_prob_threshold) {
-            if (valid_count != i) {
-                integrator->detector_proposal_clusters[valid_count] = *item;
+    size_t verified = 0;
+    while (verified < integrator->detector_proposal_clusters_count &&
+           valid_count < integrator->max_verified_clusters) {
+        size_t n = integrator->detector_proposal_clusters_count - verified;
+        if (n > integrator->verification_batch_size)
+            n = integrator->verification_batch_size;
+        object_model_predict_candidates(integrator->model, &integrator->detector_proposal_clusters[verified], n);
+        for (size_t i = verified; i < verified + n; ++i) {
+            Candidate* item = &integrator->detector_proposal_clusters[i];
+            if (item->aux_prob >= integrator->settings.model_prob_threshold) {
+                if (valid_count != i) {
+                    integrator->detector_proposal_clusters[valid_count] = *item;
+                }
+                ++valid_count;
             }
-            ++valid_count;
         }
+        verified += n;
     }
+    integrator->verified_clusters_count = verified;
     integrator->detector_proposal_clusters_count = valid_count;
+    integrator->verification_us += integrator_now_us() - verification_start;
 
     // Sort clusters by aux_prob descending
     qsort(
@@ -55,11 +103,6 @@ void integrator_preprocess_candidates(Integrator* integrator) {
                 integrator->dc_more_confident_than_tracker[i];
         }
     }
-
-    // Update tracker proposal aux_prob
-    integrator->tracker_raw_proposal.aux_prob = object_model_predict(
-        integrator->model, &integrator->tracker_raw_proposal
-    );
 }
 
 // Helper: Descending sort by aux_prob
@@ -90,6 +133,7 @@ IntegratorResult integrator_integrate(
 
     // Preprocess
     integrator_preprocess_candidates(integrator);
+    integrator->tracker_confirmed = false;
 
     int tracker_result_is_stable = tracker_proposal->valid;
     int tracker_result_confident = (integrator->tracker_raw_proposal.aux_prob > integrator->settings.model_prob_threshold);
@@ -109,6 +153,10 @@ void integrator_get_clusters(const Integrator* integrator, Candidate* out_cluste
 void integrator_set_settings(Integrator* integrator, IntegratorSettings settings) {
     integrator->settings = settings;
 }
+void integrator_set_verification_budget(Integrator* integrator, size_t batch_size, size_t max_verified_clusters) {
+    integrator->verification_batch_size = batch_size ? batch_size : 1;
+    integrator->max_verified_clusters = max_verified_clusters ? max_verified_clusters : MAX_CANDIDATES;
+}
 void integrator_subtree_detector_clusters_not_reliable(Integrator* integrator) {
     if (integrator->tracker_raw_proposal.aux_prob > 0.4) {
         integrator->final_proposal.strobe = integrator->tracker_raw_proposal.strobe;
@@ -121,6 +169,7 @@ void integrator_subtree_detector_clusters_not_reliable(Integrator* integrator) {
         if (integrator->tracker_raw_proposal.aux_prob > 0.7) {
             integrator->training_enable = true;
             integrator->tracker_relocation_enable = false;
+            integrator->tracker_confirmed = true;
             strncpy(integrator->status_message, "Only tracker's reliable result", MAX_STATUS_MSG-1);
         }
     } else {
@@ -159,6 +208,7 @@ void integrator_subtree_one_more_confident_det_cluster(Integrator* integrator) {
         integrator->final_proposal.prob = integrator->final_proposal.aux_prob;
         integrator->training_enable = true;
         integrator->tracker_relocation_enable = false;
+        integrator->tracker_confirmed = true;
         strncpy(integrator->status_message, "One Detector & Tracker are close", MAX_STATUS_MSG-1);
     }
 }
@@ -239,6 +289,9 @@ void integrator_subtree_tracker_result_is_not_reliable(Integrator* integrator) {
 const char* integrator_get_status_message(const Integrator* integrator) {
     return integrator->status_message;
 }
+bool integrator_tracker_confirmed(const Integrator* integrator) {
+    return integrator->tracker_confirmed;
+}
 
 
 
@@ -33,11 +33,23 @@ typedef struct {
     Candidate dc_close_to_tracker[MAX_CANDIDATES];
     size_t dc_close_to_tracker_count;
 
+    // Model verification of detector clusters: batch size and how many
+    // clusters have to pass before the rest is skipped (MAX_CANDIDATES, i.e.
+    // all of them, unless lowered by integrator_set_verification_budget)
+    size_t verification_batch_size;
+    size_t max_verified_clusters;
+    size_t verified_clusters_count;
+    // Time spent scoring the tracker proposal and the clusters by the model, last frame
+    double verification_us;
+
     char status_message[MAX_STATUS_MSG];
 
     Candidate final_proposal;
     bool training_enable;
     bool tracker_relocation_enable;
+    // Set when the decision confirmed the tracker ("Only tracker's reliable
+    // result" or "One Detector & Tracker are close")
+    bool tracker_confirmed;
 } Integrator;
 
 void integrator_init(Integrator* integrator, ObjectModel* model);
@@ -49,6 +61,12 @@ IntegratorResult integrator_integrate(
 void integrator_get_clusters(const Integrator* integrator, Candidate* out_clusters, size_t* out_count);
 void integrator_set_settings(Integrator* integrator, IntegratorSettings settings);
 const char* integrator_get_status_message(const Integrator* integrator);
+bool integrator_tracker_confirmed(const Integrator* integrator);
+// Opt-in cap on model verification. Clusters are verified in detector
+// probability order while the decision ranks them by model probability, so
+// with a cap the chosen cluster can differ from an exhaustive run.
+// 0 restores exhaustive verification.
+void integrator_set_verification_budget(Integrator* integrator, size_t batch_size, size_t max_verified_clusters);
 
 // Internal "private" functions (not exposed in header unless you want to)
 void integrator_preprocess_candidates(Integrator* integrator);
@@ -13,13 +13,70 @@ typedef struct {
     // ... other necessary fields ...
 } ObjectDetector;
 
-// SetFrame: Assign frame pointer and update size
+// Init: defaults for the fields not covered by DetectorSettings
+void object_detector_init(ObjectDetector* detector) {
+    detector->frame_ptr = NULL;
+    detector->integral_ptr = NULL;
+    detector->scanning_grids_count = 0;
+    detector->feat_extractors_count = 0;
+    detector->classifiers_count = 0;
+    detector->novelty_saturation = 0.9;
+    detector->novelty_min_fraction = 0.8;
+    detector->active_ferns_count = 0;
+    detector->fern_budget = 0;
+    detector->fern_score_rate = 0.05;
+}
+
+// FernBudget: number of ferns evaluated per window, 0 keeps the whole ensemble
+void object_detector_set_fern_budget(ObjectDetector* detector, int budget) {
+    detector->fern_budget = budget;
+    object_detector_rank_ferns(detector);
+}
+
+int object_detector_get_active_ferns_cnt(const ObjectDetector* detector) {
+    return detector->active_ferns_count;
+}
+
+// RankFerns: order ferns by score and keep the best fern_budget of them active
+void object_detector_rank_ferns(ObjectDetector* detector) {
+    int n = detector->classifiers_count;
+    for (int i = 0; i < n; ++i)
+        detector->active_ferns[i] = i;
+    // Insertion sort, there are at most MAX_CLASSIFIERS ferns
+    for (int i = 1; i < n; ++i) {
+        int id = detector->active_ferns[i];
+        int j = i - 1;
+        while (j >= 0 && detector->fern_score[detector->active_ferns[j]] < detector->fern_score[id]) {
+            detector->active_ferns[j + 1] = detector->active_ferns[j];
+            --j;
+        }
+        detector->active_ferns[j + 1] = id;
+    }
+    detector->active_ferns_count = (detector->fern_budget > 0 && detector->fern_budget < n) ? detector->fern_budget : n;
+}
+
+// Scores fern i on a training sample before the sample is added to its distributions
+static void object_detector_update_fern_score(ObjectDetector* detector, int i, BinaryDescriptor descriptor, int positive) {
+    double p = object_classifier_predict(&detector->classifiers[i], descriptor);
+    double hit = positive ? p : 1.0 - p;
+    detector->fern_score[i] += detector->fern_score_rate * (hit - detector->fern_score[i]);
+}
+
+// SetFrame: Assign frame pointer and update size. Grids hold pixel offsets for
+// the stride of the frame at set_target, later frames must keep it.
 void object_detector_set_frame(ObjectDetector* detector, Image* img) {
     detector->frame_ptr = img;
+    detector->integral_ptr = NULL;
     detector->frame_size.width = img->width;
     detector->frame_size.height = img->height;
 }
 
+// SetIntegral: integral images of the current frame, used by training to
+// check the stddev of sample boxes; set after set_frame
+void object_detector_set_integral(ObjectDetector* detector, const IntegralImage* integral) {
+    detector->integral_ptr = integral;
+}
+
 // Config: Store the detector settings
 void object_detector_config(ObjectDetector* detector, DetectorSettings settings) {
     detector->settings = settings;
@@ -28,7 +85,9 @@ void object_detector_config(ObjectDetector* detector, DetectorSettings settings)
 // SetTarget: Set designation, compute stddev, reset, then run training augmentator
 void object_detector_set_target(ObjectDetector* detector, Rect strobe) {
     detector->designation = strobe;
-    detector->designation_stddev = get_frame_std_dev(detector->frame_ptr, detector->designation);
+    detector->designation_stddev = detector->integral_ptr
+        ? integral_image_std_dev(detector->integral_ptr, detector->designation)
+        : get_frame_std_dev(detector->frame_ptr, detector->designation);
     object_detector_reset(detector);
 
     TransformPars aug_pars;
@@ -57,8 +116,10 @@ void object_detector_set_target(ObjectDetector* detector, Rect strobe) {
 
     Augmentator aug;
     Augmentator_init(&aug, detector->frame_ptr, detector->designation, aug_pars);
+    augmentator_set_integral(&aug, detector->integral_ptr);
 
     object_detector_init_train(detector, &aug);
+    object_detector_rank_ferns(detector);
 
     // Clean up allocations
     free(aug_pars.translation_x);
@@ -83,7 +144,8 @@ size_t object_detector_detect(
         for (int y_i = 0; y_i < positions.height; ++y_i) {
             for (int x_i = 0; x_i < positions.width; ++x_i) {
                 double ensemble_prob = 0.0;
-                for (size_t i = 0; i < detector->classifiers_count; ++i) {
+                for (int k = 0; k < detector->active_ferns_count; ++k) {
+                    int i = detector->active_ferns[k];
                     // Extract feature descriptor
                     BinaryDescriptor desc = fern_feature_extractor_call(
                         &detector->feat_extractors[i],
@@ -94,7 +156,7 @@ size_t object_detector_detect(
                     // Predict
                     ensemble_prob += object_classifier_predict(&detector->classifiers[i], desc);
                 }
-                ensemble_prob /= (double)detector->classifiers_count;
+                ensemble_prob /= (double)detector->active_ferns_count;
                 if (ensemble_prob > detector->settings.detection_probability_threshold) {
                     Candidate candidate;
                     candidate.src = PROPOSAL_SOURCE_DETECTOR;
@@ -129,7 +191,26 @@ int compare_candidate_prob_desc(const void* a, const void* b) {
     double pb = ((const Candidate*)b)->prob;
     return (pb > pa) - (pb < pa);
 }
-void object_detector_train(ObjectDetector* detector, Candidate prediction) {
+// IsNovel: cheap check on the prediction's own descriptors before running the augmentation
+int object_detector_is_novel(ObjectDetector* detector, Candidate prediction) {
+    if (detector->classifiers_count == 0)
+        return 1;
+    Rect bbox = adjust_rect_to_frame(prediction.strobe, detector->frame_size);
+    int saturated = 0;
+    for (int i = 0; i < detector->classifiers_count; ++i) {
+        BinaryDescriptor desc = fern_feature_extractor_get_descriptor_by_bbox(
+            &detector->feat_extractors[i], detector->frame_ptr, bbox);
+        if (object_classifier_predict(&detector->classifiers[i], desc) >= detector->novelty_saturation)
+            ++saturated;
+    }
+    return saturated < detector->novelty_min_fraction * detector->classifiers_count;
+}
+
+// Train: returns 1 if the ferns were updated, 0 if the prediction was already well known
+int object_detector_train(ObjectDetector* detector, Candidate prediction) {
+    if (!object_detector_is_novel(detector, prediction))
+        return 0;
+
     TransformPars aug_pars;
 
     // Fill rotation and scale arrays (assuming the arrays and their counts are set elsewhere)
@@ -151,8 +232,11 @@ void object_detector_train(ObjectDetector* detector, Candidate prediction) {
 
     Augmentator aug;
     Augmentator_init(&aug, detector->frame_ptr, prediction.strobe, aug_pars);
+    augmentator_set_integral(&aug, detector->integral_ptr);
 
     object_detector_train_internal(detector, &aug); // _train(aug) → object_detector_train_internal
+    object_detector_rank_ferns(detector);
+    return 1;
 }
 void object_detector_reset(ObjectDetector* detector) {
     // Clear arrays by resetting their counts to zero
@@ -163,7 +247,7 @@ void object_detector_reset(ObjectDetector* detector) {
     for (int i = 0; i < CLASSIFIERS_CNT; i++) {
         // Allocate and initialize ScanningGrid
         ScanningGrid* grid = (ScanningGrid*)malloc(sizeof(ScanningGrid));
-        scanning_grid_init(grid, detector->frame_size);
+        scanning_grid_init(grid, detector->frame_size, detector->frame_ptr->stride);
 
         // Set base for ScanningGrid
         scanning_grid_set_base(grid, 
@@ -187,6 +271,7 @@ void object_detector_reset(ObjectDetector* detector) {
         object_classifier_init(classifier, BINARY_DESCRIPTOR_CNT);
         detector->classifiers[i] = classifier;
         detector->classifiers_count++;
+        detector->fern_score[i] = 0.5;
     }
 }
 void object_detector_update_grid(ObjectDetector* detector, const Candidate* reference) {
@@ -202,7 +287,7 @@ void object_detector_update_grid(ObjectDetector* detector, const Candidate* refe
     }
 }
 
-void object_detector_train(ObjectDetector* detector, Augmentator* aug) {
+void object_detector_train_internal(ObjectDetector* detector, Augmentator* aug) {
     // POSITIVE
     aug->SetClass(aug, OBJECT_CLASS_POSITIVE);
     for (int s = 0; s < aug->_sample_count; ++s) {
@@ -213,6 +298,7 @@ void object_detector_train(ObjectDetector* detector, Augmentator* aug) {
             for (int i = 0; i < detector->feat_extractors_count; ++i) {
                 BinaryDescriptor descriptor =
                     feat_extractor_get_descriptor(&detector->feat_extractors[i], augm_subframe);
+                object_detector_update_fern_score(detector, i, descriptor, 1);
                 object_classifier_train_positive(&detector->classifiers[i], descriptor);
             }
         }
@@ -227,6 +313,7 @@ void object_detector_train(ObjectDetector* detector, Augmentator* aug) {
             for (int i = 0; i < detector->feat_extractors_count; ++i) {
                 BinaryDescriptor descriptor =
                     feat_extractor_get_descriptor(&detector->feat_extractors[i], augm_subframe);
+                object_detector_update_fern_score(detector, i, descriptor, 0);
                 object_classifier_train_negative(&detector->classifiers[i], descriptor);
             }
         }
@@ -239,6 +326,7 @@ void object_detector_init_train(ObjectDetector* detector, Augmentator* aug) {
         Image* augm_subframe = &aug->_sample[s];
         for (int i = 0; i < detector->feat_extractors_count; ++i) {
             BinaryDescriptor descriptor = feat_extractor_get_descriptor(&detector->feat_extractors[i], augm_subframe);
+            object_detector_update_fern_score(detector, i, descriptor, 1);
             object_classifier_train_positive(&detector->classifiers[i], descriptor);
         }
     }
@@ -248,6 +336,7 @@ void object_detector_init_train(ObjectDetector* detector, Augmentator* aug) {
         Image* augm_subframe = &aug->_sample[s];
         for (int i = 0; i < detector->feat_extractors_count; ++i) {
             BinaryDescriptor descriptor = feat_extractor_get_descriptor(&detector->feat_extractors[i], augm_subframe);
+            object_detector_update_fern_score(detector, i, descriptor, 0);
             size_t pos_max = object_classifier_get_max_positive(&detector->classifiers[i]);
             if (object_classifier_get_negative_distr(&detector->classifiers[i], descriptor) <
                 (size_t)(pos_max * detector->settings.training_init_saturation)) {
@@ -13,6 +13,7 @@
 
 typedef struct {
     Image* frame_ptr;
+    const IntegralImage* integral_ptr; // of *frame_ptr, may be NULL
     Size frame_size;
     ScanningGrid* scanning_grids[MAX_SCANNING_GRIDS];
     int scanning_grids_count;
@@ -26,16 +27,35 @@ typedef struct {
     Rect designation;
     double designation_stddev;
     DetectorSettings settings;
+
+    // Novelty gate: training is skipped when at least novelty_min_fraction of the
+    // ferns already give posterior >= novelty_saturation on the prediction
+    double novelty_saturation;
+    double novelty_min_fraction;
+
+    // Per-fern discriminativeness: running mean of the posterior a fern gave to
+    // the right class of the training samples, before it was trained on them.
+    // Detection evaluates only the fern_budget best ferns (0 = all of them).
+    double fern_score[MAX_CLASSIFIERS];
+    int active_ferns[MAX_CLASSIFIERS];
+    int active_ferns_count;
+    int fern_budget;
+    double fern_score_rate;
 } ObjectDetector;
 
 void object_detector_init(ObjectDetector* detector);
 void object_detector_set_frame(ObjectDetector* detector, Image* img);
+void object_detector_set_integral(ObjectDetector* detector, const IntegralImage* integral);
 void object_detector_set_target(ObjectDetector* detector, Rect strobe);
 void object_detector_update_grid(ObjectDetector* detector, const Candidate* reference);
-void object_detector_train(ObjectDetector* detector, Candidate prediction);
+int object_detector_train(ObjectDetector* detector, Candidate prediction);
+int object_detector_is_novel(ObjectDetector* detector, Candidate prediction);
 size_t object_detector_detect(ObjectDetector* detector, Candidate* out_candidates, size_t max_candidates);
 double object_detector_ensemble_prediction(ObjectDetector* detector, Image* img);
 void object_detector_config(ObjectDetector* detector, DetectorSettings settings);
+void object_detector_set_fern_budget(ObjectDetector* detector, int budget);
+int object_detector_get_active_ferns_cnt(const ObjectDetector* detector);
+void object_detector_rank_ferns(ObjectDetector* detector);
 
 void object_detector_reset(ObjectDetector* detector);
 void object_detector_train_internal(ObjectDetector* detector, Augmentator* aug);
@@ -1,9 +1,11 @@
 #include "object_model.h"
 #include <math.h>
+#include <string.h>
+
+_Static_assert(MODEL_PATCH_AREA == MODEL_PATCH_SIZE * MODEL_PATCH_SIZE,
+               "slab rows and normalized patches hold exactly one model patch");
 
 void object_model_init(ObjectModel* model) {
-    model->patch_size.width = 15;
-    model->patch_size.height = 15;
     model->scales[0] = 1.0;
     model->scales_count = 1;
     model->init_overlap = 0.5;
@@ -12,6 +14,11 @@ void object_model_init(ObjectModel* model) {
     model->positive_sample_count = 0;
     model->negative_sample_count = 0;
     model->frame = NULL;
+    model->last_trained_valid = 0;
+    model->novelty_ncc_threshold = 0.95;
+    model->merge_ncc_threshold = 0.97;
+    model->full_merge_ncc_threshold = 0.9;
+    model->weight_decay = 0.95f;
 }
 
 void object_model_set_frame(ObjectModel* model, Image* frame) {
@@ -20,6 +27,11 @@ void object_model_set_frame(ObjectModel* model, Image* frame) {
 void object_model_set_target(ObjectModel* model, Rect target) {
     model->target = target;
 
+    // Designation patch becomes the reference for the novelty gate
+    Candidate designation = { .strobe = target };
+    model->last_trained_valid = 0;
+    object_model_is_novel(model, designation);
+
     Image* frame = model->frame;
 
     TransformPars aug_pars;
@@ -57,17 +69,46 @@ void object_model_set_target(ObjectModel* model, Rect target) {
     Augmentator_SetClass(&aug, OBJECT_CLASS_POSITIVE);
     for (int i = 0; i < aug._sample_count; ++i) {
         Image patch = object_model_make_patch(model, &aug._sample[i]);
-        object_model_add_new_patch(model, &patch, model->positive_sample, &model->positive_sample_count, model->sample_max_depth);
+        object_model_add_new_patch(model, &patch, model->positive_sample, model->positive_slab, model->positive_weight, &model->positive_sample_count);
     }
 
     // Generate negative samples
     Augmentator_SetClass(&aug, OBJECT_CLASS_NEGATIVE);
     for (int i = 0; i < aug._sample_count; ++i) {
         Image patch = object_model_make_patch(model, &aug._sample[i]);
-        object_model_add_new_patch(model, &patch, model->negative_sample, &model->negative_sample_count, model->sample_max_depth);
+        object_model_add_new_patch(model, &patch, model->negative_sample, model->negative_slab, model->negative_weight, &model->negative_sample_count);
+    }
+}
+// Compares the candidate's patch with the last trained one and remembers it when novel
+int object_model_is_novel(ObjectModel* model, Candidate candidate) {
+    Rect strobe = adjust_rect_to_frame(candidate.strobe, image_size(model->frame));
+    Image subframe = image_subframe_clone(model->frame, strobe);
+    Image patch = object_model_make_patch(model, &subframe);
+    image_release(&subframe);
+    if (image_empty(&patch))
+        return 0;
+
+    float normalized[MODEL_PATCH_AREA];
+    object_model_normalize_patch(&patch, normalized);
+    image_release(&patch);
+
+    if (model->last_trained_valid) {
+        float ncc = 0.0f;
+        for (int i = 0; i < MODEL_PATCH_AREA; ++i)
+            ncc += normalized[i] * model->last_trained_patch[i];
+        if (ncc >= model->novelty_ncc_threshold)
+            return 0;
     }
+    memcpy(model->last_trained_patch, normalized, sizeof(normalized));
+    model->last_trained_valid = 1;
+    return 1;
 }
-void object_model_train(ObjectModel* model, Candidate candidate) {
+
+// Returns 1 if the model was updated, 0 if the candidate brought nothing new
+int object_model_train(ObjectModel* model, Candidate candidate) {
+    if (!object_model_is_novel(model, candidate))
+        return 0;
+
     Image* frame = model->frame;
 
     TransformPars aug_pars;
@@ -107,7 +148,7 @@ void object_model_train(ObjectModel* model, Candidate candidate) {
         Image patch = object_model_make_patch(model, &aug._sample[i]);
         double prob = object_model_predict(model, &patch);
         if (prob < 0.9)
-            object_model_add_new_patch(model, &patch, model->positive_sample, &model->positive_sample_count, model->sample_max_depth);
+            object_model_add_new_patch(model, &patch, model->positive_sample, model->positive_slab, model->positive_weight, &model->positive_sample_count);
     }
 
     // Negative samples
@@ -116,8 +157,9 @@ void object_model_train(ObjectModel* model, Candidate candidate) {
         Image patch = object_model_make_patch(model, &aug._sample[i]);
         double prob = object_model_predict(model, &patch);
         if (prob > 0.1)
-            object_model_add_new_patch(model, &patch, model->negative_sample, &model->negative_sample_count, model->sample_max_depth);
+            object_model_add_new_patch(model, &patch, model->negative_sample, model->negative_slab, model->negative_weight, &model->negative_sample_count);
     }
+    return 1;
 }
 double object_model_predict_candidate(const ObjectModel* model, Candidate candidate) {
     Image* src_frame = model->frame;
@@ -144,28 +186,89 @@ double object_model_predict_subframe(const ObjectModel* model, const Image* subf
     image_release(&patch);
     return result;
 }
-void object_model_add_new_patch(ObjectModel* model, Image* patch, Image* sample, int* sample_count) {
-    if (model->sample_max_depth) {
-        if (*sample_count < model->sample_max_depth) {
-            sample[*sample_count] = *patch;
-            (*sample_count)++;
-        } else {
-            int idx_2_replace = get_random_int(*sample_count - 1);
-            image_release(&sample[idx_2_replace]);
-            sample[idx_2_replace] = *patch;
+// Index of the slab row closest to the query, its NCC goes to out_ncc
+static size_t slab_nearest(const float* slab, size_t slab_count, const float* query, float* out_ncc) {
+    size_t best = 0;
+    float best_ncc = -2.0f;
+    for (size_t s = 0; s < slab_count; ++s) {
+        const float* restrict row = &slab[s * MODEL_PATCH_AREA];
+        float dot = 0.0f;
+        for (int i = 0; i < MODEL_PATCH_AREA; ++i)
+            dot += row[i] * query[i];
+        if (dot > best_ncc) {
+            best_ncc = dot;
+            best = s;
+        }
+    }
+    *out_ncc = best_ncc;
+    return best;
+}
+
+// Folds a patch into a sample as a weighted mean of its pixels and renormalizes
+// the prototype from the result, so the slab row always describes the stored image
+static void prototype_merge(Image* sample, float* proto, float* weight, const Image* patch) {
+    float w = *weight;
+    for (int y = 0; y < sample->height; ++y) {
+        uint8_t* dst = image_row(sample, y);
+        const uint8_t* src = image_row(patch, y);
+        for (int x = 0; x < sample->width; ++x)
+            dst[x] = (uint8_t)((w * dst[x] + src[x]) / (w + 1.0f) + 0.5f);
+    }
+    object_model_normalize_patch(sample, proto);
+    *weight = w + 1.0f;
+}
+
+// Adds a patch to a sample bank. A patch that nearly duplicates an existing
+// prototype is merged into it instead of taking a slot; once the bank is full the
+// merge threshold drops and, failing that, the least supported prototype is replaced.
+// Support decays with every replacement, so among equally merged prototypes the
+// oldest goes first rather than the one that was just added.
+// The patch is owned by the bank afterwards (released when merged).
+void object_model_add_new_patch(ObjectModel* model, Image* patch, Image* sample, float* slab, float* weight, size_t* sample_count) {
+    if (!model->sample_max_depth || image_empty(patch))
+        return;
+
+    float normalized[MODEL_PATCH_AREA];
+    object_model_normalize_patch(patch, normalized);
+
+    int full = *sample_count >= model->sample_max_depth;
+    if (*sample_count > 0) {
+        float ncc;
+        size_t nearest = slab_nearest(slab, *sample_count, normalized, &ncc);
+        double threshold = full ? model->full_merge_ncc_threshold : model->merge_ncc_threshold;
+        if (ncc >= threshold) {
+            prototype_merge(&sample[nearest], &slab[nearest * MODEL_PATCH_AREA], &weight[nearest], patch);
+            image_release(patch);
+            return;
+        }
+    }
+
+    size_t idx;
+    if (!full) {
+        idx = (*sample_count)++;
+    } else {
+        idx = 0;
+        for (size_t i = 0; i < *sample_count; ++i) {
+            weight[i] *= model->weight_decay;
+            if (weight[i] < weight[idx]) idx = i;
         }
+        image_release(&sample[idx]);
     }
+    sample[idx] = *patch;
+    weight[idx] = 1.0f;
+    memcpy(&slab[idx * MODEL_PATCH_AREA], normalized, sizeof(normalized));
 }
 Image object_model_make_patch(const ObjectModel* model, const Image* subframe) {
     Image patch;
     if (!image_empty(subframe)) {
-        resize_image(subframe, &patch, model->patch_size);
+        Size patch_size = { MODEL_PATCH_SIZE, MODEL_PATCH_SIZE };
+        resize_image(subframe, &patch, patch_size);
         return patch;
     } else {
         patch.data = NULL;
         patch.width = 0;
         patch.height = 0;
-        // Set other members to 0/null if needed
+        patch.stride = 0;
         return patch;
     }
 }
@@ -176,24 +279,108 @@ double object_model_similarity_coeff(const Image* patch_0, const Image* patch_1)
     return res;
 }
 
-double object_model_sample_dissimilarity(const ObjectModel* model, const Image* patch, const Image* sample, int sample_count) {
-    double out = 0.0;
-    for (int i = 0; i < sample_count; ++i) {
-        double sim = object_model_similarity_coeff(&sample[i], patch);
-        if (sim > out) out = sim;
+void object_model_normalize_patch(const Image* patch, float* out) {
+    int w = patch->width, h = patch->height;
+    double sum = 0.0;
+    for (int y = 0; y < h; ++y) {
+        const uint8_t* row = image_row(patch, y);
+        for (int x = 0; x < w; ++x)
+            sum += row[x];
+    }
+    int n = w * h;
+    float mean = (float)(sum / n);
+    double sqsum = 0.0;
+    for (int y = 0; y < h; ++y) {
+        const uint8_t* row = image_row(patch, y);
+        float* dst = out + y * w;
+        for (int x = 0; x < w; ++x) {
+            dst[x] = (float)row[x] - mean;
+            sqsum += (double)dst[x] * dst[x];
+        }
+    }
+    // Flat patch: leave it all zeros, its NCC with anything is 0 as in images_correlation
+    if (sqsum < 1e-12) return;
+    float inv_norm = (float)(1.0 / sqrt(sqsum));
+    for (int i = 0; i < n; ++i)
+        out[i] *= inv_norm;
+}
+
+// Max NCC of every query against one slab. Slab-major order: each sample row is
+// read once per call and the (few) queries stay in L1 while it streams past.
+static void slab_max_correlation(const float* slab, size_t slab_count,
+                                 const float* patches, size_t count, double* out) {
+    for (size_t c = 0; c < count; ++c)
+        out[c] = -1.0;
+    for (size_t s = 0; s < slab_count; ++s) {
+        const float* restrict row = &slab[s * MODEL_PATCH_AREA];
+        for (size_t c = 0; c < count; ++c) {
+            const float* restrict query = &patches[c * MODEL_PATCH_AREA];
+            float dot = 0.0f;
+            for (int i = 0; i < MODEL_PATCH_AREA; ++i)
+                dot += row[i] * query[i];
+            if (dot > out[c]) out[c] = dot;
+        }
+    }
+}
+
+void object_model_predict_normalized(const ObjectModel* model, const float* patches, size_t count, double* out_probs) {
+    double pos_ncc[MAX_CANDIDATES_BATCH];
+    double neg_ncc[MAX_CANDIDATES_BATCH];
+    for (size_t first = 0; first < count; first += MAX_CANDIDATES_BATCH) {
+        size_t n = count - first < MAX_CANDIDATES_BATCH ? count - first : MAX_CANDIDATES_BATCH;
+        const float* chunk = &patches[first * MODEL_PATCH_AREA];
+        slab_max_correlation(model->positive_slab, model->positive_sample_count, chunk, n, pos_ncc);
+        slab_max_correlation(model->negative_slab, model->negative_sample_count, chunk, n, neg_ncc);
+        for (size_t c = 0; c < n; ++c) {
+            // Empty bank keeps similarity 0 (dissimilarity 1), as the per-sample loop did
+            double Ppm = 1.0 - (model->positive_sample_count ? 0.5 * (pos_ncc[c] + 1.0) : 0.0);
+            double Npm = 1.0 - (model->negative_sample_count ? 0.5 * (neg_ncc[c] + 1.0) : 0.0);
+            double out = 0.0;
+            if (fabs(Npm + Ppm) > 1e-9)
+                out = Npm / (Npm + Ppm);
+            out_probs[first + c] = out;
+        }
     }
-    return 1.0 - out;
 }
 
 double object_model_predict(const ObjectModel* model, const Image* patch) {
-    double out = 0.0;
-    double Npm = object_model_sample_dissimilarity(model, patch, model->negative_sample, model->negative_sample_count);
-    double Ppm = object_model_sample_dissimilarity(model, patch, model->positive_sample, model->positive_sample_count);
-    if (fabs(Npm + Ppm) > 1e-9)
-        out = Npm / (Npm + Ppm);
+    float normalized[MODEL_PATCH_AREA];
+    double out;
+    object_model_normalize_patch(patch, normalized);
+    object_model_predict_normalized(model, normalized, 1, &out);
     return out;
 }
 
+// Scores candidates in one pass over the sample slabs and writes the result to aux_prob.
+// Returns the number of candidates whose patch could be built (the rest get 0).
+size_t object_model_predict_candidates(const ObjectModel* model, Candidate* candidates, size_t count) {
+    float patches[MAX_CANDIDATES_BATCH * MODEL_PATCH_AREA];
+    double probs[MAX_CANDIDATES_BATCH];
+    size_t index[MAX_CANDIDATES_BATCH];
+    size_t scored = 0;
+    for (size_t first = 0; first < count; first += MAX_CANDIDATES_BATCH) {
+        size_t n = 0;
+        size_t last = count - first < MAX_CANDIDATES_BATCH ? count : first + MAX_CANDIDATES_BATCH;
+        for (size_t i = first; i < last; ++i) {
+            Rect strobe = adjust_rect_to_frame(candidates[i].strobe, image_size(model->frame));
+            candidates[i].aux_prob = 0.0;
+            Image subframe = image_subframe_clone(model->frame, strobe);
+            Image patch = object_model_make_patch(model, &subframe);
+            if (!image_empty(&patch)) {
+                object_model_normalize_patch(&patch, &patches[n * MODEL_PATCH_AREA]);
+                index[n++] = i;
+            }
+            image_release(&patch);
+            image_release(&subframe);
+        }
+        object_model_predict_normalized(model, patches, n, probs);
+        for (size_t k = 0; k < n; ++k)
+            candidates[index[k]].aux_prob = probs[k];
+        scored += n;
+    }
+    return scored;
+}
+
 // Return positive sample array, up to user to manage allocation
 void object_model_get_positive_sample(const ObjectModel* model, Image* out_array, int* out_count) {
     for (int i = 0; i < model->positive_sample_count; ++i)
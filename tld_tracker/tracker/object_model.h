@@ -6,9 +6,12 @@
 
 #define MAX_SCALES 16
 #define MAX_SAMPLE_DEPTH 128
+// Samples are resized to square patches of this side; slab rows hold one patch
+#define MODEL_PATCH_SIZE 15
+#define MODEL_PATCH_AREA (MODEL_PATCH_SIZE * MODEL_PATCH_SIZE)
+#define MAX_CANDIDATES_BATCH 16
 
 typedef struct {
-    Size patch_size;
     Image* frame;
     Rect target;
     double scales[MAX_SCALES];
@@ -20,22 +23,46 @@ typedef struct {
     size_t positive_sample_count;
     Image negative_sample[MAX_SAMPLE_DEPTH];
     size_t negative_sample_count;
+    // Zero-mean, unit-norm copies of the samples stored back to back, so the
+    // NCC against the whole bank is a run of dot products
+    float positive_slab[MAX_SAMPLE_DEPTH * MODEL_PATCH_AREA];
+    float negative_slab[MAX_SAMPLE_DEPTH * MODEL_PATCH_AREA];
+    // Number of patches merged into each prototype, decayed by weight_decay on
+    // every replacement; patches correlating above merge_ncc_threshold
+    // (full_merge_ncc_threshold once the bank is full) with an existing
+    // prototype are averaged into its sample image instead of taking a new slot.
+    // The weights only choose which prototype to evict: the NN confidence stays
+    // the plain maximum NCC, so a heavily merged prototype scores like a one-off.
+    float positive_weight[MAX_SAMPLE_DEPTH];
+    float negative_weight[MAX_SAMPLE_DEPTH];
+    double merge_ncc_threshold;
+    double full_merge_ncc_threshold;
+    float weight_decay;
+    // Novelty gate: normalized patch of the last update; an update whose patch
+    // correlates above novelty_ncc_threshold with it is skipped
+    float last_trained_patch[MODEL_PATCH_AREA];
+    int last_trained_valid;
+    double novelty_ncc_threshold;
 } ObjectModel;
 
 void object_model_init(ObjectModel* model);
 void object_model_set_frame(ObjectModel* model, Image* frame);
 void object_model_set_target(ObjectModel* model, Rect target);
-void object_model_train(ObjectModel* model, Candidate candidate);
+int object_model_train(ObjectModel* model, Candidate candidate);
+int object_model_is_novel(ObjectModel* model, Candidate candidate);
 double object_model_predict_candidate(const ObjectModel* model, Candidate candidate);
 double object_model_predict_subframe(const ObjectModel* model, const Image* subframe);
+size_t object_model_predict_candidates(const ObjectModel* model, Candidate* candidates, size_t count);
 size_t object_model_get_positive_sample(const ObjectModel* model, Image* out_samples, size_t max_count);
 size_t object_model_get_negative_sample(const ObjectModel* model, Image* out_samples, size_t max_count);
 
 // Internal equivalents
 void object_model_make_patch(const ObjectModel* model, const Image* subframe, Image* out_patch);
-void object_model_add_new_patch(ObjectModel* model, Image* patch, Image* sample_array, size_t* sample_count);
+void object_model_add_new_patch(ObjectModel* model, Image* patch, Image* sample_array, float* slab, float* weight, size_t* sample_count);
+// out receives width * height values (MODEL_PATCH_AREA for a model patch)
+void object_model_normalize_patch(const Image* patch, float* out);
+void object_model_predict_normalized(const ObjectModel* model, const float* patches, size_t count, double* out_probs);
 double object_model_similarity_coeff(const ObjectModel* model, const Image* subframe_0, const Image* subframe_1);
-double object_model_sample_dissimilarity(const ObjectModel* model, Image* patch, const Image* sample_array, size_t sample_count);
 double object_model_predict_patch(const ObjectModel* model, const Image* patch);
 
 #endif
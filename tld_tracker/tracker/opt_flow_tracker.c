@@ -3,14 +3,88 @@
 
 void opt_flow_tracker_init(OptFlowTracker* tracker) {
     memset(tracker, 0, sizeof(OptFlowTracker));
+    image_pyramid_init(&tracker->cur_pyr);
+    image_pyramid_init(&tracker->prev_pyr);
+    tracker->lk_pars.win_size = 5;
+    tracker->lk_pars.max_level = 3;
+    tracker->lk_pars.max_iter = 100;
+    tracker->lk_pars.epsilon = 0.01f;
+    tracker->lk_pars.min_eig_threshold = 0.001f;
+    tracker->point_selection = POINT_SELECTION_MIN_EIGEN;
+    tracker->max_points_ceiling = 100;
+    tracker->max_level_ceiling = 3;
+    tracker->max_iter_ceiling = 100;
+    tracker->points_budget = 100;
+    tracker->last_fb_error = -1.0;
+    tracker->last_motion = 0.0;
+}
+
+void opt_flow_tracker_set_limits(OptFlowTracker* tracker, size_t max_points, int max_level, int max_iter) {
+    tracker->max_points_ceiling = max_points < MAX_TRACKED_POINTS ? max_points : MAX_TRACKED_POINTS;
+    if (max_level < 0) max_level = 0;
+    tracker->max_level_ceiling = max_level < MAX_PYR_LEVELS - 1 ? max_level : MAX_PYR_LEVELS - 1;
+    tracker->max_iter_ceiling = max_iter > 0 ? max_iter : 1;
+}
+
+// Picks the point count and LK parameters for the current frame
+static void opt_flow_tracker_adapt(OptFlowTracker* tracker, Rect target) {
+    // About one point per 8x8 block of the target, at least 16
+    size_t points = (size_t)rect_area(target) / 64;
+    if (points < 16) points = 16;
+    if (points > tracker->max_points_ceiling) points = tracker->max_points_ceiling;
+    tracker->points_budget = points;
+
+    // Enough levels to cover the last motion (each level doubles the reach of
+    // the window), but no level where the target gets smaller than the window.
+    // Without a previous frame to go by the full depth is used.
+    int half = tracker->lk_pars.win_size / 2;
+    int level = tracker->last_fb_error < 0.0 ? tracker->max_level_ceiling : 0;
+    while (level < tracker->max_level_ceiling &&
+           (double)(half << level) < 1.5 * tracker->last_motion + 2.0)
+        ++level;
+    int min_side = target.width < target.height ? target.width : target.height;
+    while (level > 0 && (min_side >> level) < tracker->lk_pars.win_size)
+        --level;
+    tracker->lk_pars.max_level = level;
+
+    // Few iterations suffice while points come back to where they started
+    int iter = tracker->max_iter_ceiling;
+    if (tracker->last_fb_error >= 0.0) {
+        if (tracker->last_fb_error < 0.25) iter /= 4;
+        else if (tracker->last_fb_error < 0.5) iter /= 2;
+    }
+    tracker->lk_pars.max_iter = iter < 5 ? (tracker->max_iter_ceiling < 5 ? tracker->max_iter_ceiling : 5) : iter;
+}
+
+void opt_flow_tracker_free(OptFlowTracker* tracker) {
+    image_pyramid_free(&tracker->cur_pyr);
+    image_pyramid_free(&tracker->prev_pyr);
+    feature_scratch_free(&tracker->feature_scratch);
+    median_flow_scratch_free(&tracker->median_scratch);
 }
 
 void opt_flow_tracker_set_frame(OptFlowTracker* tracker, const Image* frame) {
-    tracker->prev_frame = tracker->current_frame;
-    tracker->current_frame = *frame;
+    // Reuse the current pyramid (and its buffers) as the previous one. If it was
+    // not built on the last frame there is nothing to track from.
+    image_pyramid_swap(&tracker->prev_pyr, &tracker->cur_pyr);
+    tracker->prev_pyr_ready = tracker->cur_pyr_ready;
+    tracker->cur_pyr_ready = 0;
+    tracker->frame_ptr = frame;
+    tracker->prev_frame = tracker->prev_pyr.levels[0].img;
+}
+
+// Builds the pyramid of the current frame, once per frame
+void opt_flow_tracker_prepare(OptFlowTracker* tracker) {
+    if (tracker->cur_pyr_ready || !tracker->frame_ptr)
+        return;
+    image_pyramid_build(&tracker->cur_pyr, tracker->frame_ptr, tracker->max_level_ceiling);
+    tracker->current_frame = tracker->cur_pyr.levels[0].img;
+    tracker->cur_pyr_ready = 1;
 }
 
 void opt_flow_tracker_set_target(OptFlowTracker* tracker, Rect2d strobe) {
+    // The next frame tracks from this one
+    opt_flow_tracker_prepare(tracker);
     tracker->target = strobe;
     tracker->center.x = strobe.x + 0.5 * strobe.width;
     tracker->center.y = strobe.y + 0.5 * strobe.height;
@@ -20,73 +94,116 @@ void opt_flow_tracker_set_target(OptFlowTracker* tracker, Rect2d strobe) {
 #include "opt_flow_tracker.h"
 #include <math.h>
 
+// Regular grid of up to max_points points inside roi, margin pixels from its edges
+static size_t opt_flow_tracker_grid_points(Rect roi, size_t max_points, int margin, Point2f* out) {
+    int side = (int)sqrt((double)max_points);
+    int span_x = roi.width - 2 * margin;
+    int span_y = roi.height - 2 * margin;
+    if (side < 2 || span_x <= 0 || span_y <= 0)
+        return 0;
+    size_t count = 0;
+    for (int j = 0; j < side; ++j) {
+        for (int i = 0; i < side; ++i) {
+            out[count].x = (float)(roi.x + margin + (double)span_x * i / (side - 1));
+            out[count].y = (float)(roi.y + margin + (double)span_y * j / (side - 1));
+            ++count;
+        }
+    }
+    return count;
+}
+
 Candidate opt_flow_tracker_track(OptFlowTracker* tracker) {
     Candidate out;
     out.src = PROPOSAL_SOURCE_TRACKER; // Use your enum value
     out.valid = 0;
 
-    if ((fabs(rect2d_area(tracker->target)) < 1e-10) ||
-        image_empty(&tracker->prev_frame) ||
-        image_empty(&tracker->current_frame))
+    if ((fabs(rect2d_area(tracker->target)) < 1e-10) || !tracker->prev_pyr_ready)
+        return out;
+    opt_flow_tracker_prepare(tracker);
+    if (!tracker->cur_pyr_ready)
         return out;
 
-    Image mask;
-    image_create(&mask, tracker->prev_frame.height, tracker->prev_frame.width, IMAGE_TYPE_U8C1); // Or your image alloc
-    image_set_zero(&mask);
-
-    Rect2d target_inside_frame = adjust_rect_to_frame(tracker->target,
-                                (Size2d){mask.width, mask.height});
+    Rect target_inside_frame = adjust_rect_to_frame(
+        (Rect){ (int)tracker->target.x, (int)tracker->target.y,
+                (int)tracker->target.width, (int)tracker->target.height },
+        image_size(&tracker->prev_frame));
 
-    Image target_subframe = image_subframe(&mask, target_inside_frame);
-    image_set_value(&target_subframe, 255);
+    opt_flow_tracker_adapt(tracker, target_inside_frame);
 
-    Point2f prev_points[100];
+    // Points are picked inside the target only, no frame-sized buffers involved
+    Point2f prev_points[MAX_TRACKED_POINTS];
     size_t prev_points_count = 0;
-    good_features_to_track(&tracker->prev_frame, prev_points, &prev_points_count, 100, 0.01, 10.0, &mask, 7, 0, 0.04);
-
-    if (prev_points_count > 0) {
-        corner_sub_pix(&tracker->prev_frame, prev_points, prev_points_count,
-                       (Size2d){3,3}, (Size2d){-1,-1}, 100, 0.01);
+    if (tracker->point_selection == POINT_SELECTION_GRID) {
+        prev_points_count = opt_flow_tracker_grid_points(target_inside_frame, tracker->points_budget,
+                                                         tracker->lk_pars.win_size / 2, prev_points);
+    } else {
+        // Spread denser points closer together, never further apart than 10 px
+        double min_distance = 0.5 * sqrt((double)rect_area(target_inside_frame) / tracker->points_budget);
+        if (min_distance > 10.0) min_distance = 10.0;
+        if (min_distance < 3.0) min_distance = 3.0;
+        prev_points_count = image_pyramid_select_features(&tracker->prev_pyr, target_inside_frame,
+                                                          tracker->points_budget, 0.01, min_distance,
+                                                          &tracker->feature_scratch, prev_points);
     }
 
-    Point2f cur_points[100];
-    unsigned char cur_status[100];
-    Point2f backtrace[100];
-    unsigned char backtrace_status[100];
-    float err[100];
+    Point2f cur_points[MAX_TRACKED_POINTS];
+    unsigned char cur_status[MAX_TRACKED_POINTS];
+    Point2f backtrace[MAX_TRACKED_POINTS];
+    unsigned char backtrace_status[MAX_TRACKED_POINTS];
+    float err[MAX_TRACKED_POINTS];
 
     size_t cur_points_count = 0, backtrace_count = 0;
 
     if (prev_points_count > 0) {
-        calc_optical_flow_pyr_lk(&tracker->prev_frame, &tracker->current_frame,
-                                 prev_points, prev_points_count, cur_points, cur_status, err,
-                                 (Size2d){5,5}, 3, 100, 0.01, 0, 0.001);
-        calc_optical_flow_pyr_lk(&tracker->current_frame, &tracker->prev_frame,
-                                 cur_points, prev_points_count, backtrace, backtrace_status, err,
-                                 (Size2d){5,5}, 3, 100, 0.01, 0, 0.001);
+        pyr_lk_track(&tracker->prev_pyr, &tracker->cur_pyr,
+                     prev_points, cur_points, prev_points_count, cur_status, err, tracker->lk_pars);
+        pyr_lk_track(&tracker->cur_pyr, &tracker->prev_pyr,
+                     cur_points, backtrace, prev_points_count, backtrace_status, err, tracker->lk_pars);
 
         tracker->prev_out_points_count = 0;
         tracker->cur_out_points_count = 0;
 
+        // Forward-backward errors and motion of the tracked points feed the next
+        // frame's budget; err[] is free to reuse after the backward pass
+        float* motion = err;
+        float fb_error[MAX_TRACKED_POINTS];
+        size_t fb_count = 0;
+
         for (size_t i = 0; i < prev_points_count; i++) {
             if (cur_status[i] && backtrace_status[i]) {
                 double dx = prev_points[i].x - backtrace[i].x;
                 double dy = prev_points[i].y - backtrace[i].y;
                 double dist = sqrt(dx*dx + dy*dy);
+                double mx = cur_points[i].x - prev_points[i].x;
+                double my = cur_points[i].y - prev_points[i].y;
+                fb_error[fb_count] = (float)dist;
+                motion[fb_count] = (float)sqrt(mx*mx + my*my);
+                ++fb_count;
                 if (dist <= 1.0) {
                     tracker->prev_out_points[tracker->prev_out_points_count++] = prev_points[i];
                     tracker->cur_out_points[tracker->cur_out_points_count++] = cur_points[i];
                 }
             }
         }
+        if (fb_count > 0) {
+            tracker->last_fb_error = select_kth(fb_error, fb_count, fb_count / 2);
+            tracker->last_motion = select_kth(motion, fb_count, fb_count / 2);
+        } else {
+            // Everything lost: search with full depth and iterations next time
+            tracker->last_fb_error = -1.0;
+        }
     }
 
     Point2d mean_shift = {0,0};
     double mean_scale = 1.0;
 
     if (tracker->prev_out_points_count > 3) {
-        mean_shift = get_mean_shift(tracker->prev_out_points, tracker->cur_out_points, tracker->prev_out_points_count);
-        mean_scale = get_scale(tracker->prev_out_points, tracker->cur_out_points, tracker->prev_out_points_count);
+        Point2f median_shift = get_median_shift(tracker->prev_out_points, tracker->cur_out_points,
+                                                tracker->prev_out_points_count, &tracker->median_scratch);
+        mean_shift.x = median_shift.x;
+        mean_shift.y = median_shift.y;
+        mean_scale = get_median_scale(tracker->prev_out_points, tracker->cur_out_points,
+                                      tracker->prev_out_points_count, &tracker->median_scratch);
 
         tracker->center.x += mean_shift.x;
         tracker->center.y += mean_shift.y;
@@ -103,9 +220,6 @@ Candidate opt_flow_tracker_track(OptFlowTracker* tracker) {
         out.valid = 0;
     }
 
-    image_release(&mask);
-    image_release(&target_subframe);
-
     return out;
 }
 
@@ -2,9 +2,15 @@
 #define OPT_FLOW_TRACKER_H
 
 #include "tld_utils.h"
+#include "pyr_lk.h"
 #include <stddef.h>
 
 #define MAX_POINTS 1024
+#define MAX_TRACKED_POINTS 256
+
+// How points to track are picked inside the target
+#define POINT_SELECTION_GRID 0       // regular grid, as in the original median flow
+#define POINT_SELECTION_MIN_EIGEN 1  // Shi-Tomasi corners restricted to the target
 
 typedef struct {
     double x, y;
@@ -18,19 +24,33 @@ typedef struct {
     double x, y, width, height;
 } Rect2d;
 
-// Replace Image with your image/matrix struct (for cv::Mat)
-typedef struct {
-    unsigned char* data;
-    int width;
-    int height;
-    int channels;
-    // add fields as needed
-} Image;
-
 typedef struct {
     Rect2d target;
     Point2d center;
     Size2d size;
+    // The current pyramid is built on the first use in a frame (tracking or a
+    // new target) and becomes the previous one on the next frame; both LK
+    // passes share them. A frame the tracker is idle on builds nothing.
+    ImagePyramid cur_pyr;
+    ImagePyramid prev_pyr;
+    const Image* frame_ptr;
+    int cur_pyr_ready;
+    int prev_pyr_ready;
+    LkParams lk_pars;
+    int point_selection;
+    // Adaptive budget: points, pyramid depth and LK iterations are picked per
+    // frame from the target size and the last frame's forward-backward error,
+    // never above these ceilings
+    size_t max_points_ceiling;
+    int max_level_ceiling;
+    int max_iter_ceiling;
+    size_t points_budget;
+    double last_fb_error;   // median forward-backward error of the last frame, px
+    double last_motion;     // median displacement of the last frame, px
+    FeatureScratch feature_scratch;
+    MedianFlowScratch median_scratch;
+    // Views of the frames the pyramids were built on; the pixels belong to the
+    // caller of set_frame, which keeps the previous frame alive
     Image current_frame;
     Image prev_frame;
     Point2d prev_points[MAX_POINTS];
@@ -51,7 +71,10 @@ typedef struct {
 
 // Constructors and API
 void opt_flow_tracker_init(OptFlowTracker* tracker);
+void opt_flow_tracker_free(OptFlowTracker* tracker);
+void opt_flow_tracker_set_limits(OptFlowTracker* tracker, size_t max_points, int max_level, int max_iter);
 void opt_flow_tracker_set_frame(OptFlowTracker* tracker, const Image* frame);
+void opt_flow_tracker_prepare(OptFlowTracker* tracker);
 void opt_flow_tracker_set_target(OptFlowTracker* tracker, Rect2d strobe);
 Candidate opt_flow_tracker_track(OptFlowTracker* tracker);
 
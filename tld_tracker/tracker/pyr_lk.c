@@ -0,0 +1,454 @@
+#include "pyr_lk.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Bilinear weights are 14-bit; image samples keep 5 fractional bits so they share
+// the scale of the Scharr derivatives (kernel gain 32)
+#define LK_W_BITS 14
+#define LK_I_BITS 5
+#define LK_DESCALE(x, n) (((x) + (1 << ((n) - 1))) >> (n))
+#define LK_FLT_SCALE (1.0f / (1 << 20))
+
+static inline int clamp_index(int i, int size) {
+    return i < 0 ? 0 : (i >= size ? size - 1 : i);
+}
+
+// Upper levels get a one-pixel border, enough for the derivative kernel
+static void pyramid_level_alloc(PyramidLevel* level, int width, int height) {
+    if (level->img.data && level->img.width == width && level->img.height == height)
+        return;
+    image_free(&level->img);
+    free(level->deriv);
+    level->img = image_create_padded(width, height, 1);
+    level->deriv = (int16_t*)malloc(sizeof(int16_t) * 2 * (size_t)width * height);
+}
+
+// 2x decimation with a [1 2 1] x [1 2 1] / 16 kernel, borders replicated
+static void pyramid_down(const Image* src, Image* dst) {
+    int sw = src->width, sh = src->height;
+    for (int y = 0; y < dst->height; ++y) {
+        const uint8_t* r0 = image_row(src, clamp_index(2 * y - 1, sh));
+        const uint8_t* r1 = image_row(src, clamp_index(2 * y, sh));
+        const uint8_t* r2 = image_row(src, clamp_index(2 * y + 1, sh));
+        uint8_t* out = image_row(dst, y);
+        int x = 0;
+        for (; x < dst->width && 2 * x - 1 < 0; ++x) {
+            int xl = clamp_index(2 * x - 1, sw), xc = clamp_index(2 * x, sw), xr = clamp_index(2 * x + 1, sw);
+            int v = r0[xl] + 2 * r0[xc] + r0[xr] +
+                    2 * (r1[xl] + 2 * r1[xc] + r1[xr]) +
+                    r2[xl] + 2 * r2[xc] + r2[xr];
+            out[x] = (uint8_t)((v + 8) >> 4);
+        }
+        // Interior: no clamping, the loop auto-vectorizes
+        int x_end = (sw - 2) / 2 + 1;
+        if (x_end > dst->width) x_end = dst->width;
+        for (; x < x_end; ++x) {
+            int c = 2 * x;
+            int v = r0[c - 1] + 2 * r0[c] + r0[c + 1] +
+                    2 * (r1[c - 1] + 2 * r1[c] + r1[c + 1]) +
+                    r2[c - 1] + 2 * r2[c] + r2[c + 1];
+            out[x] = (uint8_t)((v + 8) >> 4);
+        }
+        for (; x < dst->width; ++x) {
+            int xl = clamp_index(2 * x - 1, sw), xc = clamp_index(2 * x, sw), xr = clamp_index(2 * x + 1, sw);
+            int v = r0[xl] + 2 * r0[xc] + r0[xr] +
+                    2 * (r1[xl] + 2 * r1[xc] + r1[xr]) +
+                    r2[xl] + 2 * r2[xc] + r2[xr];
+            out[x] = (uint8_t)((v + 8) >> 4);
+        }
+    }
+}
+
+// Scharr derivatives (3, 10, 3), borders replicated
+static void pyramid_derivatives(PyramidLevel* level) {
+    const Image* img = &level->img;
+    int w = img->width, h = img->height;
+    if (img->border >= 1) {
+        // Neighbours outside the image are in the border: no clamping at all
+        for (int y = 0; y < h; ++y) {
+            const uint8_t* r0 = image_row(img, y - 1);
+            const uint8_t* r1 = image_row(img, y);
+            const uint8_t* r2 = image_row(img, y + 1);
+            int16_t* d = level->deriv + 2 * y * w;
+            for (int x = 0; x < w; ++x) {
+                d[2 * x] = (int16_t)(3 * (r0[x + 1] - r0[x - 1]) + 10 * (r1[x + 1] - r1[x - 1]) +
+                                     3 * (r2[x + 1] - r2[x - 1]));
+                d[2 * x + 1] = (int16_t)(3 * (r2[x - 1] - r0[x - 1]) + 10 * (r2[x] - r0[x]) +
+                                         3 * (r2[x + 1] - r0[x + 1]));
+            }
+        }
+        return;
+    }
+    for (int y = 0; y < h; ++y) {
+        const uint8_t* r0 = image_row(img, clamp_index(y - 1, h));
+        const uint8_t* r1 = image_row(img, y);
+        const uint8_t* r2 = image_row(img, clamp_index(y + 1, h));
+        int16_t* d = level->deriv + 2 * y * w;
+        for (int x = 0; x < w; ++x) {
+            int xl = x > 0 ? x - 1 : 0;
+            int xr = x < w - 1 ? x + 1 : w - 1;
+            d[2 * x] = (int16_t)(3 * (r0[xr] - r0[xl]) + 10 * (r1[xr] - r1[xl]) + 3 * (r2[xr] - r2[xl]));
+            d[2 * x + 1] = (int16_t)(3 * (r2[xl] - r0[xl]) + 10 * (r2[x] - r0[x]) + 3 * (r2[xr] - r0[xr]));
+        }
+    }
+}
+
+void image_pyramid_init(ImagePyramid* pyr) {
+    memset(pyr, 0, sizeof(ImagePyramid));
+}
+
+// Level 0 is a view of the frame: only its derivatives are allocated
+static void pyramid_base_view(PyramidLevel* level, const Image* frame) {
+    if (!level->deriv || level->img.width != frame->width || level->img.height != frame->height) {
+        free(level->deriv);
+        level->deriv = (int16_t*)malloc(sizeof(int16_t) * 2 * (size_t)frame->width * frame->height);
+    }
+    level->img = *frame;
+}
+
+void image_pyramid_build(ImagePyramid* pyr, const Image* frame, int max_level) {
+    if (max_level > MAX_PYR_LEVELS - 1) max_level = MAX_PYR_LEVELS - 1;
+    pyramid_base_view(&pyr->levels[0], frame);
+    pyramid_derivatives(&pyr->levels[0]);
+    pyr->levels_count = 1;
+    for (int l = 1; l <= max_level; ++l) {
+        const Image* src = &pyr->levels[l - 1].img;
+        int w = (src->width + 1) / 2, h = (src->height + 1) / 2;
+        if (w < MAX_LK_WIN_SIZE || h < MAX_LK_WIN_SIZE)
+            break;
+        pyramid_level_alloc(&pyr->levels[l], w, h);
+        pyramid_down(src, &pyr->levels[l].img);
+        image_replicate_border(&pyr->levels[l].img);
+        pyramid_derivatives(&pyr->levels[l]);
+        pyr->levels_count++;
+    }
+}
+
+void image_pyramid_swap(ImagePyramid* a, ImagePyramid* b) {
+    ImagePyramid tmp = *a;
+    *a = *b;
+    *b = tmp;
+}
+
+void image_pyramid_free(ImagePyramid* pyr) {
+    for (int l = 0; l < MAX_PYR_LEVELS; ++l) {
+        if (l > 0)
+            image_free(&pyr->levels[l].img);
+        free(pyr->levels[l].deriv);
+    }
+    image_pyramid_init(pyr);
+}
+
+int image_pyramid_empty(const ImagePyramid* pyr) {
+    return pyr->levels_count == 0;
+}
+
+static int compare_feature_desc(const void* a, const void* b) {
+    float ra = ((const FeatureCandidate*)a)->response;
+    float rb = ((const FeatureCandidate*)b)->response;
+    return (rb > ra) - (rb < ra);
+}
+
+size_t image_pyramid_select_features(const ImagePyramid* pyr, Rect roi, size_t max_points,
+                                     double quality_level, double min_distance,
+                                     FeatureScratch* scratch, Point2f* out_points) {
+    if (image_pyramid_empty(pyr) || max_points == 0)
+        return 0;
+    const PyramidLevel* level = &pyr->levels[0];
+    int w = level->img.width, h = level->img.height;
+
+    // 3x3 structure tensor blocks have to stay inside the frame
+    int x0 = roi.x < 1 ? 1 : roi.x;
+    int y0 = roi.y < 1 ? 1 : roi.y;
+    int x1 = roi.x + roi.width > w - 1 ? w - 1 : roi.x + roi.width;
+    int y1 = roi.y + roi.height > h - 1 ? h - 1 : roi.y + roi.height;
+    int rw = x1 - x0, rh = y1 - y0;
+    if (rw < 3 || rh < 3)
+        return 0;
+
+    size_t area = (size_t)rw * rh;
+    if (scratch->capacity < area) {
+        free(scratch->response);
+        free(scratch->candidates);
+        scratch->response = (float*)malloc(sizeof(float) * area);
+        scratch->candidates = (FeatureCandidate*)malloc(sizeof(FeatureCandidate) * area);
+        scratch->capacity = area;
+    }
+
+    // Min eigenvalue of the structure tensor per pixel
+    float max_response = 0.f;
+    for (int y = y0; y < y1; ++y) {
+        float* resp = scratch->response + (y - y0) * rw;
+        for (int x = x0; x < x1; ++x) {
+            int a = 0, b = 0, c = 0;
+            for (int dy = -1; dy <= 1; ++dy) {
+                const int16_t* d = level->deriv + 2 * ((y + dy) * w + x - 1);
+                for (int k = 0; k < 3; ++k) {
+                    int gx = d[2 * k], gy = d[2 * k + 1];
+                    a += gx * gx;
+                    b += gx * gy;
+                    c += gy * gy;
+                }
+            }
+            float fa = (float)a, fb = (float)b, fc = (float)c;
+            float lambda = 0.5f * ((fa + fc) - sqrtf((fa - fc) * (fa - fc) + 4.f * fb * fb));
+            resp[x - x0] = lambda;
+            if (lambda > max_response) max_response = lambda;
+        }
+    }
+    if (max_response <= 0.f)
+        return 0;
+
+    // Local maxima above the quality level
+    float threshold = (float)(quality_level * max_response);
+    size_t n = 0;
+    for (int y = 1; y < rh - 1; ++y) {
+        const float* r = scratch->response + y * rw;
+        for (int x = 1; x < rw - 1; ++x) {
+            float v = r[x];
+            if (v <= threshold) continue;
+            if (v < r[x - 1] || v < r[x + 1] ||
+                v < r[x - rw - 1] || v < r[x - rw] || v < r[x - rw + 1] ||
+                v < r[x + rw - 1] || v < r[x + rw] || v < r[x + rw + 1])
+                continue;
+            scratch->candidates[n].response = v;
+            scratch->candidates[n].x = x + x0;
+            scratch->candidates[n].y = y + y0;
+            ++n;
+        }
+    }
+    qsort(scratch->candidates, n, sizeof(FeatureCandidate), compare_feature_desc);
+
+    // Strongest first, keeping min_distance between selected corners
+    double min_dist2 = min_distance * min_distance;
+    size_t selected = 0;
+    for (size_t i = 0; i < n && selected < max_points; ++i) {
+        float cx = (float)scratch->candidates[i].x, cy = (float)scratch->candidates[i].y;
+        int far_enough = 1;
+        for (size_t j = 0; j < selected; ++j) {
+            float dx = out_points[j].x - cx, dy = out_points[j].y - cy;
+            if (dx * dx + dy * dy < min_dist2) {
+                far_enough = 0;
+                break;
+            }
+        }
+        if (far_enough) {
+            out_points[selected].x = cx;
+            out_points[selected].y = cy;
+            ++selected;
+        }
+    }
+    return selected;
+}
+
+void feature_scratch_free(FeatureScratch* scratch) {
+    free(scratch->response);
+    free(scratch->candidates);
+    scratch->response = NULL;
+    scratch->candidates = NULL;
+    scratch->capacity = 0;
+}
+
+static int lk_simd_enabled = 1;
+
+void pyr_lk_set_simd(int enable) {
+    lk_simd_enabled = enable;
+}
+
+// Mismatch vector contribution of one window row: sum of (J - I) * (dx, dy)
+static void lk_row_mismatch(const uint8_t* J, int stride, const int16_t* iwin, const int16_t* dwin,
+                            int win, int iw00, int iw01, int iw10, int iw11, int* b1, int* b2) {
+    int x = 0;
+    int acc1 = 0, acc2 = 0;
+#if defined(__SSE2__)
+    __m128i z = _mm_setzero_si128();
+    __m128i qw0 = _mm_set1_epi32((iw00 & 0xffff) | (iw01 << 16));
+    __m128i qw1 = _mm_set1_epi32((iw10 & 0xffff) | (iw11 << 16));
+    __m128i qdelta = _mm_set1_epi32(1 << (LK_W_BITS - LK_I_BITS - 1));
+    __m128i qb = z;
+    for (; lk_simd_enabled && x <= win - 4; x += 4) {
+        int p00, p01, p10, p11;
+        memcpy(&p00, J + x, 4);
+        memcpy(&p01, J + x + 1, 4);
+        memcpy(&p10, J + x + stride, 4);
+        memcpy(&p11, J + x + stride + 1, 4);
+        __m128i v00 = _mm_unpacklo_epi8(_mm_cvtsi32_si128(p00), z);
+        __m128i v01 = _mm_unpacklo_epi8(_mm_cvtsi32_si128(p01), z);
+        __m128i v10 = _mm_unpacklo_epi8(_mm_cvtsi32_si128(p10), z);
+        __m128i v11 = _mm_unpacklo_epi8(_mm_cvtsi32_si128(p11), z);
+        __m128i t = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(v00, v01), qw0),
+                                  _mm_madd_epi16(_mm_unpacklo_epi16(v10, v11), qw1));
+        t = _mm_srai_epi32(_mm_add_epi32(t, qdelta), LK_W_BITS - LK_I_BITS);
+        __m128i ival = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(iwin + x)), z);
+        __m128i diff = _mm_packs_epi32(_mm_sub_epi32(t, ival), z);
+        diff = _mm_unpacklo_epi16(diff, diff);
+        __m128i ixy = _mm_loadu_si128((const __m128i*)(dwin + 2 * x));
+        __m128i lo = _mm_mullo_epi16(diff, ixy);
+        __m128i hi = _mm_mulhi_epi16(diff, ixy);
+        qb = _mm_add_epi32(qb, _mm_unpacklo_epi16(lo, hi));
+        qb = _mm_add_epi32(qb, _mm_unpackhi_epi16(lo, hi));
+    }
+    int lanes[4];
+    _mm_storeu_si128((__m128i*)lanes, qb);
+    acc1 = lanes[0] + lanes[2];
+    acc2 = lanes[1] + lanes[3];
+#endif
+    for (; x < win; ++x) {
+        int jval = LK_DESCALE(J[x] * iw00 + J[x + 1] * iw01 + J[x + stride] * iw10 + J[x + stride + 1] * iw11,
+                              LK_W_BITS - LK_I_BITS);
+        int diff = jval - iwin[x];
+        acc1 += diff * dwin[2 * x];
+        acc2 += diff * dwin[2 * x + 1];
+    }
+    *b1 += acc1;
+    *b2 += acc2;
+}
+
+static void lk_weights(float fx, float fy, int* iw00, int* iw01, int* iw10, int* iw11) {
+    *iw00 = (int)lrintf((1.f - fx) * (1.f - fy) * (1 << LK_W_BITS));
+    *iw01 = (int)lrintf(fx * (1.f - fy) * (1 << LK_W_BITS));
+    *iw10 = (int)lrintf((1.f - fx) * fy * (1 << LK_W_BITS));
+    *iw11 = (1 << LK_W_BITS) - *iw00 - *iw01 - *iw10;
+}
+
+// Refines (*nx, *ny) on one level for the window centered at (px, py).
+// Returns 0 if the point left the level or the window has no texture.
+static int lk_refine_level(const PyramidLevel* I, const PyramidLevel* J, float px, float py,
+                           float* nx, float* ny, const LkParams* pars, float* err) {
+    int16_t iwin[MAX_LK_WIN_SIZE * MAX_LK_WIN_SIZE];
+    int16_t dwin[MAX_LK_WIN_SIZE * MAX_LK_WIN_SIZE * 2];
+    int win = pars->win_size;
+    int half = win / 2;
+    // Derivatives are packed (w per row), images may have any stride
+    int w = I->img.width, h = I->img.height;
+    int is = I->img.stride, js = J->img.stride;
+
+    float x0 = px - half, y0 = py - half;
+    int ix = (int)floorf(x0), iy = (int)floorf(y0);
+    if (ix < 0 || iy < 0 || ix + win + 1 >= w || iy + win + 1 >= h)
+        return 0;
+
+    int iw00, iw01, iw10, iw11;
+    lk_weights(x0 - ix, y0 - iy, &iw00, &iw01, &iw10, &iw11);
+
+    double A11 = 0.0, A12 = 0.0, A22 = 0.0;
+    for (int y = 0; y < win; ++y) {
+        const uint8_t* src = image_row(&I->img, iy + y) + ix;
+        const int16_t* d = I->deriv + 2 * ((iy + y) * w + ix);
+        int16_t* irow = iwin + y * win;
+        int16_t* drow = dwin + 2 * y * win;
+        int a11 = 0, a12 = 0, a22 = 0;
+        for (int x = 0; x < win; ++x) {
+            int ival = LK_DESCALE(src[x] * iw00 + src[x + 1] * iw01 + src[x + is] * iw10 + src[x + is + 1] * iw11,
+                                  LK_W_BITS - LK_I_BITS);
+            int dxv = LK_DESCALE(d[2 * x] * iw00 + d[2 * x + 2] * iw01 +
+                                 d[2 * x + 2 * w] * iw10 + d[2 * x + 2 * w + 2] * iw11, LK_W_BITS);
+            int dyv = LK_DESCALE(d[2 * x + 1] * iw00 + d[2 * x + 3] * iw01 +
+                                 d[2 * x + 2 * w + 1] * iw10 + d[2 * x + 2 * w + 3] * iw11, LK_W_BITS);
+            irow[x] = (int16_t)ival;
+            drow[2 * x] = (int16_t)dxv;
+            drow[2 * x + 1] = (int16_t)dyv;
+            a11 += dxv * dxv;
+            a12 += dxv * dyv;
+            a22 += dyv * dyv;
+        }
+        A11 += a11;
+        A12 += a12;
+        A22 += a22;
+    }
+    A11 *= LK_FLT_SCALE;
+    A12 *= LK_FLT_SCALE;
+    A22 *= LK_FLT_SCALE;
+
+    double D = A11 * A22 - A12 * A12;
+    double min_eig = (A22 + A11 - sqrt((A11 - A22) * (A11 - A22) + 4.0 * A12 * A12)) / (2.0 * win * win);
+    if (min_eig < pars->min_eig_threshold || D < FLT_EPSILON)
+        return 0;
+    D = 1.0 / D;
+
+    int jx = 0, jy = 0;
+    int jw00 = 0, jw01 = 0, jw10 = 0, jw11 = 0;
+    for (int iter = 0; iter < pars->max_iter; ++iter) {
+        float jx0 = *nx - half, jy0 = *ny - half;
+        jx = (int)floorf(jx0);
+        jy = (int)floorf(jy0);
+        if (jx < 0 || jy < 0 || jx + win + 1 >= w || jy + win + 1 >= h)
+            return 0;
+        lk_weights(jx0 - jx, jy0 - jy, &jw00, &jw01, &jw10, &jw11);
+
+        double b1 = 0.0, b2 = 0.0;
+        for (int y = 0; y < win; ++y) {
+            int rb1 = 0, rb2 = 0;
+            lk_row_mismatch(image_row(&J->img, jy + y) + jx, js, iwin + y * win, dwin + 2 * y * win,
+                            win, jw00, jw01, jw10, jw11, &rb1, &rb2);
+            b1 += rb1;
+            b2 += rb2;
+        }
+        b1 *= LK_FLT_SCALE;
+        b2 *= LK_FLT_SCALE;
+
+        float dx = (float)((A12 * b2 - A22 * b1) * D);
+        float dy = (float)((A12 * b1 - A11 * b2) * D);
+        *nx += dx;
+        *ny += dy;
+        if (dx * dx + dy * dy <= pars->epsilon * pars->epsilon)
+            break;
+    }
+
+    if (err) {
+        float jx0 = *nx - half, jy0 = *ny - half;
+        jx = (int)floorf(jx0);
+        jy = (int)floorf(jy0);
+        if (jx < 0 || jy < 0 || jx + win + 1 >= w || jy + win + 1 >= h)
+            return 0;
+        lk_weights(jx0 - jx, jy0 - jy, &jw00, &jw01, &jw10, &jw11);
+        int sum = 0;
+        for (int y = 0; y < win; ++y) {
+            const uint8_t* Jrow = image_row(&J->img, jy + y) + jx;
+            for (int x = 0; x < win; ++x) {
+                int jval = LK_DESCALE(Jrow[x] * jw00 + Jrow[x + 1] * jw01 + Jrow[x + js] * jw10 + Jrow[x + js + 1] * jw11,
+                                      LK_W_BITS - LK_I_BITS);
+                sum += abs(jval - iwin[y * win + x]);
+            }
+        }
+        *err = (float)sum / (32.f * win * win);
+    }
+    return 1;
+}
+
+void pyr_lk_track(const ImagePyramid* prev, const ImagePyramid* next,
+                  const Point2f* prev_points, Point2f* next_points, size_t count,
+                  uint8_t* status, float* err, LkParams pars) {
+    if (pars.win_size > MAX_LK_WIN_SIZE) pars.win_size = MAX_LK_WIN_SIZE;
+    if (pars.win_size < 3) pars.win_size = 3;
+    int top = pars.max_level;
+    if (top > prev->levels_count - 1) top = prev->levels_count - 1;
+    if (top > next->levels_count - 1) top = next->levels_count - 1;
+
+    for (size_t i = 0; i < count; ++i) {
+        float gx = 0.f, gy = 0.f;
+        float nx = 0.f, ny = 0.f;
+        status[i] = 1;
+        if (err) err[i] = 0.f;
+        for (int l = top; l >= 0; --l) {
+            float scale = 1.f / (float)(1 << l);
+            float px = prev_points[i].x * scale, py = prev_points[i].y * scale;
+            nx = px + gx;
+            ny = py + gy;
+            if (!lk_refine_level(&prev->levels[l], &next->levels[l], px, py, &nx, &ny, &pars,
+                                 (l == 0 && err) ? &err[i] : NULL)) {
+                status[i] = 0;
+                break;
+            }
+            gx = 2.f * (nx - px);
+            gy = 2.f * (ny - py);
+        }
+        next_points[i].x = status[i] ? nx : prev_points[i].x;
+        next_points[i].y = status[i] ? ny : prev_points[i].y;
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef PYR_LK_H
+#define PYR_LK_H
+
+#include "tld_utils.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define MAX_PYR_LEVELS 8
+#define MAX_LK_WIN_SIZE 31
+
+// Pyramid level: 8-bit image plus its Scharr derivatives in fixed point
+// (32 x pixel units), stored interleaved as (dx, dy) pairs
+typedef struct {
+    Image img;
+    int16_t* deriv;
+} PyramidLevel;
+
+// Buffers are kept between builds, so a pyramid rebuilt for every frame of the
+// same size does not allocate after the first one. Level 0 is not copied: it
+// refers to the frame passed to build, which must outlive the pyramid's use.
+typedef struct {
+    PyramidLevel levels[MAX_PYR_LEVELS];
+    int levels_count;
+} ImagePyramid;
+
+typedef struct {
+    int win_size;              // odd, at most MAX_LK_WIN_SIZE
+    int max_level;             // pyramid levels above the base one
+    int max_iter;
+    float epsilon;
+    float min_eig_threshold;
+} LkParams;
+
+// Working memory of feature selection, sized by the ROI and kept between calls
+typedef struct {
+    float response;
+    int x, y;
+} FeatureCandidate;
+
+typedef struct {
+    float* response;
+    FeatureCandidate* candidates;
+    size_t capacity;
+} FeatureScratch;
+
+void image_pyramid_init(ImagePyramid* pyr);
+void image_pyramid_build(ImagePyramid* pyr, const Image* frame, int max_level);
+void image_pyramid_swap(ImagePyramid* a, ImagePyramid* b);
+void image_pyramid_free(ImagePyramid* pyr);
+int image_pyramid_empty(const ImagePyramid* pyr);
+
+// Shi-Tomasi corners inside roi, computed from the base level derivatives.
+// Touches only the ROI: cost scales with the object, not the frame.
+size_t image_pyramid_select_features(const ImagePyramid* pyr, Rect roi, size_t max_points,
+                                     double quality_level, double min_distance,
+                                     FeatureScratch* scratch, Point2f* out_points);
+void feature_scratch_free(FeatureScratch* scratch);
+
+// Pyramidal Lucas-Kanade between two prebuilt pyramids. next_points is used as
+// output only; status[i] is 0 for points lost or too close to the border.
+void pyr_lk_track(const ImagePyramid* prev, const ImagePyramid* next,
+                  const Point2f* prev_points, Point2f* next_points, size_t count,
+                  uint8_t* status, float* err, LkParams pars);
+
+// Whether the SSE2 kernels are used where compiled in (default 1). The scalar
+// path gives the same results bit for bit; the switch is for tests and benchmarks.
+void pyr_lk_set_simd(int enable);
+
+#endif
@@ -7,8 +7,9 @@
 #define OVERLAP_ERROR      "ScanningGrid has received zero or negative overlap!"
 #define SCALE_ERROR        "ScanningGrid has received zero or negative base scale!"
 #define LARGE_SCALE_ERROR  "ScanningGrid scale larger than image!"
-void scanning_grid_init(ScanningGrid* grid, Size frame_size) {
+void scanning_grid_init(ScanningGrid* grid, Size frame_size, int frame_stride) {
     grid->frame_size = frame_size;
+    grid->frame_stride = frame_stride;
     fern_init(&grid->fern, BINARY_DESCRIPTOR_WIDTH); // BINARY_DESCRIPTOR_WIDTH is a macro or constant
     grid->base_bbox.width = 0;
     grid->base_bbox.height = 0;
@@ -20,6 +21,7 @@ void scanning_grid_init(ScanningGrid* grid, Size frame_size) {
 }
 void scanning_grid_copy(ScanningGrid* dest, const ScanningGrid* src) {
     dest->frame_size = src->frame_size;
+    dest->frame_stride = src->frame_stride;
     fern_copy(&dest->fern, &src->fern); // Assume fern_copy is defined
 
     dest->base_bbox = src->base_bbox;
@@ -117,8 +119,8 @@ void scanning_grid_set_base(ScanningGrid* grid, Size bbox, double overlap, const
         grid->zero_shifted_counts[i] = fern_pair_count;
         grid->zero_shifted[i] = (PixelIdPair*)malloc(sizeof(PixelIdPair) * fern_pair_count);
         for (size_t j = 0; j < fern_pair_count; ++j) {
-            size_t offset0 = (size_t)(fern_base[j].first.x + fern_base[j].first.y * grid->frame_size.width);
-            size_t offset1 = (size_t)(fern_base[j].second.x + fern_base[j].second.y * grid->frame_size.width);
+            size_t offset0 = (size_t)(fern_base[j].first.x + fern_base[j].first.y * grid->frame_stride);
+            size_t offset1 = (size_t)(fern_base[j].second.x + fern_base[j].second.y * grid->frame_stride);
             grid->zero_shifted[i][j].p1 = offset0;
             grid->zero_shifted[i][j].p2 = offset1;
         }
@@ -172,8 +174,9 @@ PixelIdPair* scanning_grid_get_pixel_pairs(
     int x_offset = position.width * step_x;
     int y_offset = position.height * step_y;
 
-    // Assuming row stride (step[0]) in bytes, but with PixelIdPair, use frame->width (or as appropriate)
-    int linear_offset = x_offset + y_offset * frame->width;
+    // The zero-shifted offsets were computed for grid->frame_stride, which has
+    // to be the stride of frame
+    int linear_offset = x_offset + y_offset * frame->stride;
 
     for (size_t i = 0; i < base_count; ++i) {
         out_pairs[i].p1 = grid->zero_shifted[scale_idx][i].p1 + linear_offset;
@@ -196,7 +199,7 @@ PixelIdPair* scanning_grid_get_pixel_pairs_bbox(
     PixelIdPair* out_pairs = (PixelIdPair*)malloc(sizeof(PixelIdPair) * n_fern);
 
     for (size_t i = 0; i < n_fern; ++i) {
-        // frame->stride should be the number of pixels per row (not bytes)
+        // Stride is in pixels, which for 8-bit frames is also bytes
         size_t p1_offset = (local_coords[i].first.x + bbox.x) + (local_coords[i].first.y + bbox.y) * frame->stride;
         size_t p2_offset = (local_coords[i].second.x + bbox.x) + (local_coords[i].second.y + bbox.y) * frame->stride;
         out_pairs[i].p1 = p1_offset;
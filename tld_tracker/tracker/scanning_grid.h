@@ -22,6 +22,7 @@ typedef struct {
 
 typedef struct {
     Size frame_size;
+    int frame_stride;   // row stride the pixel offsets are computed for
     Fern fern;
     Size base_bbox;
     double scales[MAX_SCALES];
@@ -33,7 +34,7 @@ typedef struct {
     size_t zero_shifted_count[MAX_ZERO_SHIFTED]; // count of pairs for each scale/shift
 } ScanningGrid;
 
-void scanning_grid_init(ScanningGrid* grid, Size frame_size);
+void scanning_grid_init(ScanningGrid* grid, Size frame_size, int frame_stride);
 void scanning_grid_copy(ScanningGrid* dst, const ScanningGrid* src);
 void scanning_grid_set_base(ScanningGrid* grid, Size bbox, double overlap, const double* scales, size_t scales_count);
 
@@ -0,0 +1,81 @@
+#define _POSIX_C_SOURCE 200112L // nanosleep
+#include "spsc_queue.h"
+#include <sched.h>
+#include <stdlib.h>
+#include <time.h>
+
+int spsc_queue_init(SpscQueue* queue, size_t capacity) {
+    size_t size = 2;
+    while (size < capacity)
+        size <<= 1;
+    queue->slots = (void**)calloc(size, sizeof(void*));
+    queue->mask = queue->slots ? size - 1 : 0;
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+    queue->tail_cache = 0;
+    queue->head_cache = 0;
+    return queue->slots != NULL;
+}
+
+void spsc_queue_free(SpscQueue* queue) {
+    free(queue->slots);
+    queue->slots = NULL;
+    queue->mask = 0;
+}
+
+size_t spsc_queue_capacity(const SpscQueue* queue) {
+    return queue->slots ? queue->mask + 1 : 0;
+}
+
+int spsc_queue_try_push(SpscQueue* queue, void* item) {
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    if (tail - queue->head_cache > queue->mask) {
+        queue->head_cache = atomic_load_explicit(&queue->head, memory_order_acquire);
+        if (tail - queue->head_cache > queue->mask)
+            return 0;
+    }
+    queue->slots[tail & queue->mask] = item;
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+    return 1;
+}
+
+int spsc_queue_try_pop(SpscQueue* queue, void** item) {
+    size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    if (head == queue->tail_cache) {
+        queue->tail_cache = atomic_load_explicit(&queue->tail, memory_order_acquire);
+        if (head == queue->tail_cache)
+            return 0;
+    }
+    *item = queue->slots[head & queue->mask];
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+    return 1;
+}
+
+// A stage waiting on the other one is usually waiting for a whole frame, so
+// after a few rounds it sleeps instead of burning the core the other stage
+// may need.
+static void spsc_backoff(int* round) {
+    if (*round < 64) {
+        ++*round;
+    } else if (*round < 80) {
+        ++*round;
+        sched_yield();
+    } else {
+        struct timespec ts = { 0, 50000 };
+        nanosleep(&ts, NULL);
+    }
+}
+
+void spsc_queue_push(SpscQueue* queue, void* item) {
+    int round = 0;
+    while (!spsc_queue_try_push(queue, item))
+        spsc_backoff(&round);
+}
+
+void* spsc_queue_pop(SpscQueue* queue) {
+    void* item = NULL;
+    int round = 0;
+    while (!spsc_queue_try_pop(queue, &item))
+        spsc_backoff(&round);
+    return item;
+}
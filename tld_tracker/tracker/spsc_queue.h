@@ -0,0 +1,35 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+#define SPSC_CACHE_LINE 64
+
+// Bounded lock-free queue of pointers between exactly one producer thread and
+// one consumer thread. The two indices live on separate cache lines, and each
+// side keeps a private copy of the other's index, so the shared lines are only
+// touched when the queue looks full (producer) or empty (consumer).
+typedef struct {
+    void** slots;
+    size_t mask;                                    // capacity - 1, capacity a power of two
+    _Alignas(SPSC_CACHE_LINE) atomic_size_t head;   // next slot to pop, written by the consumer
+    size_t tail_cache;                              // consumer's view of tail
+    _Alignas(SPSC_CACHE_LINE) atomic_size_t tail;   // next slot to push, written by the producer
+    size_t head_cache;                              // producer's view of head
+} SpscQueue;
+
+// Capacity is rounded up to a power of two. Returns 0 on allocation failure.
+int spsc_queue_init(SpscQueue* queue, size_t capacity);
+void spsc_queue_free(SpscQueue* queue);
+size_t spsc_queue_capacity(const SpscQueue* queue);
+
+// Non-blocking; return 0 if the queue is full / empty. NULL items are allowed.
+int spsc_queue_try_push(SpscQueue* queue, void* item);   // producer only
+int spsc_queue_try_pop(SpscQueue* queue, void** item);   // consumer only
+
+// Blocking variants: spin briefly, then yield, then sleep in short steps
+void spsc_queue_push(SpscQueue* queue, void* item);
+void* spsc_queue_pop(SpscQueue* queue);
+
+#endif
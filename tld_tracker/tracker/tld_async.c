@@ -0,0 +1,238 @@
+#include "tld_async.h"
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+int64_t tld_async_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Called with the lock held
+static void tld_async_drop_head(TldAsyncTracker* async) {
+    TldAsyncSlot* slot = &async->slots[async->queue[async->queue_head]];
+    if (slot->has_target) {
+        async->carried = 1;
+        async->carried_target = slot->target;
+    }
+    slot->state = TLD_SLOT_FREE;
+    async->queue_head = (async->queue_head + 1) % TLD_ASYNC_MAX_DEPTH;
+    async->queue_count--;
+    async->dropped++;
+    async->dropped_pending++;
+}
+
+static void tld_async_push_result(TldAsyncTracker* async, const TldAsyncResult* result) {
+    if (async->results_count == TLD_ASYNC_RESULTS) {
+        async->results_head = (async->results_head + 1) % TLD_ASYNC_RESULTS;
+        async->results_count--;
+    }
+    async->results[(async->results_head + async->results_count) % TLD_ASYNC_RESULTS] = *result;
+    async->results_count++;
+}
+
+static void* tld_async_worker(void* arg) {
+    TldAsyncTracker* async = (TldAsyncTracker*)arg;
+    pthread_mutex_lock(&async->lock);
+    while (1) {
+        while (async->queue_count == 0 && !async->stop)
+            pthread_cond_wait(&async->frame_queued, &async->lock);
+        if (async->stop)
+            break;
+        int idx = async->queue[async->queue_head];
+        async->queue_head = (async->queue_head + 1) % TLD_ASYNC_MAX_DEPTH;
+        async->queue_count--;
+        TldAsyncSlot* slot = &async->slots[idx];
+        slot->state = TLD_SLOT_PROCESSING;
+
+        TldAsyncResult result;
+        result.frame_id = slot->frame_id;
+        result.timestamp_us = slot->timestamp_us;
+        result.dropped_before = async->dropped_pending;
+        async->dropped_pending = 0;
+        int64_t start_us = tld_async_now_us();
+        result.queue_delay_us = start_us - slot->submit_us;
+        pthread_mutex_unlock(&async->lock);
+
+        result.candidate = tld_tracker_process_frame_borrowed(async->tracker, &slot->img);
+        if (slot->has_target)
+            tld_tracker_start_tracking(async->tracker, slot->target);
+        int64_t end_us = tld_async_now_us();
+        result.process_us = end_us - start_us;
+        result.latency_us = end_us - slot->submit_us;
+
+        pthread_mutex_lock(&async->lock);
+        // The tracker lets go of its previous frame on every call
+        if (async->held >= 0)
+            async->slots[async->held].state = TLD_SLOT_FREE;
+        async->held = idx;
+        slot->state = TLD_SLOT_HELD;
+        pthread_cond_broadcast(&async->slot_freed);
+        tld_async_push_result(async, &result);
+        pthread_cond_broadcast(&async->result_ready);
+    }
+    pthread_mutex_unlock(&async->lock);
+    return NULL;
+}
+
+int tld_async_init(TldAsyncTracker* async, TldTracker* tracker, int depth, TldQueuePolicy policy) {
+    memset(async, 0, sizeof(TldAsyncTracker));
+    if (depth < 1) depth = 1;
+    if (depth > TLD_ASYNC_MAX_DEPTH) depth = TLD_ASYNC_MAX_DEPTH;
+    async->tracker = tracker;
+    async->policy = policy;
+    async->depth = policy == TLD_QUEUE_KEEP_LATEST ? 1 : depth;
+    async->slots_count = async->depth + 3;
+    async->held = -1;
+    pthread_mutex_init(&async->lock, NULL);
+    pthread_cond_init(&async->frame_queued, NULL);
+    pthread_cond_init(&async->slot_freed, NULL);
+    pthread_cond_init(&async->result_ready, NULL);
+    if (pthread_create(&async->worker, NULL, tld_async_worker, async) != 0) {
+        pthread_mutex_destroy(&async->lock);
+        pthread_cond_destroy(&async->frame_queued);
+        pthread_cond_destroy(&async->slot_freed);
+        pthread_cond_destroy(&async->result_ready);
+        return 0;
+    }
+    return 1;
+}
+
+void tld_async_free(TldAsyncTracker* async) {
+    pthread_mutex_lock(&async->lock);
+    async->stop = 1;
+    pthread_cond_broadcast(&async->frame_queued);
+    pthread_cond_broadcast(&async->slot_freed);
+    pthread_cond_broadcast(&async->result_ready);
+    pthread_mutex_unlock(&async->lock);
+    pthread_join(async->worker, NULL);
+    for (int i = 0; i < async->slots_count; ++i)
+        image_free(&async->slots[i].img);
+    pthread_mutex_destroy(&async->lock);
+    pthread_cond_destroy(&async->frame_queued);
+    pthread_cond_destroy(&async->slot_freed);
+    pthread_cond_destroy(&async->result_ready);
+}
+
+// Copy and padding happen on the caller's thread, outside the lock, so the
+// tracker never waits for a submit
+static int tld_async_enqueue(TldAsyncTracker* async, const Image* frame, int64_t timestamp_us,
+                             const Rect* target) {
+    int64_t submit_us = tld_async_now_us();
+    pthread_mutex_lock(&async->lock);
+    if (async->policy == TLD_QUEUE_KEEP_LATEST) {
+        while (async->queue_count > 0)
+            tld_async_drop_head(async);
+    } else if (async->policy == TLD_QUEUE_DROP_OLDEST) {
+        if (async->queue_count == async->depth)
+            tld_async_drop_head(async);
+    } else {
+        while (async->queue_count == async->depth && !async->stop)
+            pthread_cond_wait(&async->slot_freed, &async->lock);
+    }
+    if (async->stop) {
+        pthread_mutex_unlock(&async->lock);
+        return 0;
+    }
+    // With at most depth frames pending, one processed and one held, one of
+    // the depth + 3 slots is free
+    TldAsyncSlot* slot = NULL;
+    for (int i = 0; i < async->slots_count && !slot; ++i)
+        if (async->slots[i].state == TLD_SLOT_FREE)
+            slot = &async->slots[i];
+    slot->state = TLD_SLOT_FILLING;
+    slot->frame_id = async->submitted++;
+    pthread_mutex_unlock(&async->lock);
+
+    Image* img = &slot->img;
+    if (!img->data || img->width != frame->width || img->height != frame->height) {
+        image_free(img);
+        *img = image_create_padded(frame->width, frame->height, TLD_FRAME_BORDER);
+    }
+    if (img->data) {
+        for (int y = 0; y < frame->height; ++y)
+            memcpy(image_row(img, y), image_row(frame, y), frame->width);
+        image_replicate_border(img);
+    }
+    slot->timestamp_us = timestamp_us;
+    slot->submit_us = submit_us;
+
+    pthread_mutex_lock(&async->lock);
+    if (!img->data) {
+        slot->state = TLD_SLOT_FREE;
+        pthread_mutex_unlock(&async->lock);
+        return 0;
+    }
+    slot->has_target = target != NULL;
+    if (target) {
+        slot->target = *target;
+        async->carried = 0;
+    } else if (async->carried) {
+        slot->has_target = 1;
+        slot->target = async->carried_target;
+        async->carried = 0;
+    }
+    slot->state = TLD_SLOT_QUEUED;
+    async->queue[(async->queue_head + async->queue_count) % TLD_ASYNC_MAX_DEPTH] = (int)(slot - async->slots);
+    async->queue_count++;
+    pthread_cond_signal(&async->frame_queued);
+    pthread_mutex_unlock(&async->lock);
+    return 1;
+}
+
+int tld_async_submit(TldAsyncTracker* async, const Image* frame, int64_t timestamp_us) {
+    return tld_async_enqueue(async, frame, timestamp_us, NULL);
+}
+
+int tld_async_submit_with_target(TldAsyncTracker* async, const Image* frame, int64_t timestamp_us,
+                                 Rect target) {
+    return tld_async_enqueue(async, frame, timestamp_us, &target);
+}
+
+// Called with the lock held
+static int tld_async_take_result(TldAsyncTracker* async, TldAsyncResult* out) {
+    if (async->results_count == 0)
+        return 0;
+    *out = async->results[async->results_head];
+    async->results_head = (async->results_head + 1) % TLD_ASYNC_RESULTS;
+    async->results_count--;
+    return 1;
+}
+
+int tld_async_poll(TldAsyncTracker* async, TldAsyncResult* out) {
+    pthread_mutex_lock(&async->lock);
+    int got = tld_async_take_result(async, out);
+    pthread_mutex_unlock(&async->lock);
+    return got;
+}
+
+int tld_async_wait(TldAsyncTracker* async, TldAsyncResult* out, int timeout_ms) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    if (timeout_ms >= 0) {
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+    }
+    pthread_mutex_lock(&async->lock);
+    int got;
+    while (!(got = tld_async_take_result(async, out)) && !async->stop) {
+        if (timeout_ms < 0)
+            pthread_cond_wait(&async->result_ready, &async->lock);
+        else if (pthread_cond_timedwait(&async->result_ready, &async->lock, &deadline) == ETIMEDOUT)
+            break;
+    }
+    pthread_mutex_unlock(&async->lock);
+    return got;
+}
+
+uint64_t tld_async_dropped(TldAsyncTracker* async) {
+    pthread_mutex_lock(&async->lock);
+    uint64_t dropped = async->dropped;
+    pthread_mutex_unlock(&async->lock);
+    return dropped;
+}
@@ -0,0 +1,98 @@
+#ifndef TLD_ASYNC_H
+#define TLD_ASYNC_H
+
+#include "tld_tracker.h"
+#include <pthread.h>
+#include <stdint.h>
+
+// What submit does when every queue slot holds a frame not yet processed
+typedef enum {
+    TLD_QUEUE_DROP_OLDEST,   // replace the oldest pending frame
+    TLD_QUEUE_KEEP_LATEST,   // every submit drops all pending frames
+    TLD_QUEUE_BLOCK          // wait for the tracker to take a frame
+} TldQueuePolicy;
+
+#define TLD_ASYNC_MAX_DEPTH 8
+#define TLD_ASYNC_RESULTS 16
+
+typedef struct {
+    Candidate candidate;
+    uint64_t frame_id;         // submission number, from 0
+    int64_t timestamp_us;      // as given to submit
+    int64_t queue_delay_us;    // submit to start of processing
+    int64_t process_us;
+    int64_t latency_us;        // submit to result
+    uint64_t dropped_before;   // frames dropped since the previous result
+} TldAsyncResult;
+
+typedef enum {
+    TLD_SLOT_FREE,
+    TLD_SLOT_FILLING,    // being copied into by submit
+    TLD_SLOT_QUEUED,
+    TLD_SLOT_PROCESSING,
+    TLD_SLOT_HELD        // the tracker's previous frame
+} TldSlotState;
+
+typedef struct {
+    Image img;
+    TldSlotState state;
+    uint64_t frame_id;
+    int64_t timestamp_us;
+    int64_t submit_us;
+    int has_target;      // start tracking target after this frame
+    Rect target;
+} TldAsyncSlot;
+
+// Runs a tracker on a worker thread. Frames are copied into the queue on
+// submit, so the caller's buffer is free as soon as submit returns; results
+// are read back with poll or wait, oldest first (the oldest are overwritten
+// if they are not read).
+typedef struct {
+    TldTracker* tracker;
+    TldQueuePolicy policy;
+    int depth;                   // pending frames at most
+    // Pending frames, one being processed, the tracker's previous one and one
+    // being filled by submit
+    TldAsyncSlot slots[TLD_ASYNC_MAX_DEPTH + 3];
+    int slots_count;
+    int queue[TLD_ASYNC_MAX_DEPTH];   // indices of pending slots, oldest first
+    int queue_head, queue_count;
+    TldAsyncResult results[TLD_ASYNC_RESULTS];
+    int results_head, results_count;
+    uint64_t submitted;
+    uint64_t dropped;            // total
+    uint64_t dropped_pending;    // since the last result
+    int carried;                 // target of a dropped frame, for the next one
+    Rect carried_target;
+    int held;                    // slot of the tracker's previous frame, or -1
+    int stop;
+    pthread_mutex_t lock;
+    pthread_cond_t frame_queued;
+    pthread_cond_t slot_freed;
+    pthread_cond_t result_ready;
+    pthread_t worker;
+} TldAsyncTracker;
+
+// Monotonic clock the queueing delays are measured with. Timestamps taken with
+// it at capture give glass-to-result latency as result time minus timestamp.
+int64_t tld_async_now_us(void);
+
+// tracker is used only by the worker thread until tld_async_free returns. Its
+// last frames are freed along with the queue, so stop tracking before giving
+// it frames directly again. Submit from one thread at a time.
+int tld_async_init(TldAsyncTracker* async, TldTracker* tracker, int depth, TldQueuePolicy policy);
+void tld_async_free(TldAsyncTracker* async);
+
+// Both return 1 if the frame was queued, 0 if not (allocation failure). A
+// target starts tracking right after its frame is processed; it moves to the
+// next frame if its own one is dropped.
+int tld_async_submit(TldAsyncTracker* async, const Image* frame, int64_t timestamp_us);
+int tld_async_submit_with_target(TldAsyncTracker* async, const Image* frame, int64_t timestamp_us,
+                                 Rect target);
+
+// 1 if a result was taken. wait gives up after timeout_ms (< 0: never).
+int tld_async_poll(TldAsyncTracker* async, TldAsyncResult* out);
+int tld_async_wait(TldAsyncTracker* async, TldAsyncResult* out, int timeout_ms);
+uint64_t tld_async_dropped(TldAsyncTracker* async);
+
+#endif
@@ -1,5 +1,8 @@
 #include "tld_tracker.h"
 #include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
 
 void tld_tracker_print(FILE* out, const TldTracker* tracker) {
     TldStatus status = tld_tracker_get_status(tracker);
@@ -13,9 +16,12 @@ void tld_tracker_print(FILE* out, const TldTracker* tracker) {
     fprintf(out, "Size (W/H):\t%d/%d\n", pred.strobe.width, pred.strobe.height);
     fprintf(out, "Center (X/Y):\t%d/%d\n", pred.strobe.x, pred.strobe.y);
     fprintf(out, "Training status:\t%s\n", status.training ? "enable" : "disable");
+    fprintf(out, "Training skipped:\t%d\n", status.training_skipped_cnt);
+    fprintf(out, "Fast path:\t%s\n", status.fast_path ? "enable" : "disable");
     fprintf(out, "Relocation flag:\t%s\n", status.tracker_relocation ? "enable" : "disable");
     fprintf(out, "Detector proposals:\t%d\n", status.detector_candidates_cnt);
     fprintf(out, "Detector clusters:\t%d\n", status.detector_clusters_cnt);
+    fprintf(out, "Active ferns:\t%d\n", status.active_ferns_cnt);
     fprintf(out, "Status:\t\t%s\n", status.message ? status.message : "");
     fprintf(out, "\n");
 }
@@ -37,34 +43,247 @@ TldTracker make_tld_tracker_with_settings(const Settings* s) {
 // Constructor logic, sets fields. Add any extra zeroing or initialization needed.
 void tld_tracker_init(TldTracker* tracker, Settings settings) {
     tracker->_settings = settings;
+    object_detector_init(&tracker->_detector);
     object_model_init(&tracker->_model);
+    opt_flow_tracker_init(&tracker->_tracker);
     integrator_init(&tracker->_integrator, &tracker->_model);
     tracker->_processing_en = 0;
+    tracker->_training_skipped_cnt = 0;
+    tracker->_fast_path_en = 0;
+    tracker->_fast_path_enter_frames = 10;
+    tracker->_fast_path_verify_period = 5;
+    tracker->_fast_path_min_tracker_prob = 0.7;
+    tracker->_fast_path_min_model_prob = 0.7;
+    tracker->_stable_frames_cnt = 0;
+    tracker->_fast_path_frames_cnt = 0;
+    tracker->_fast_path_active = 0;
+    tracker->_parallel_en = 0;
+    tracker->_track_worker_running = 0;
+    frame_cache_init(&tracker->_frames, 7, TLD_FRAME_BORDER); // 7x7 low-pass kernel
+    frame_ring_init(&tracker->_ring, TLD_FRAME_BORDER);
+    tracker->_cur_buf = NULL;
+    tracker->_prev_buf = NULL;
+    tracker->_lent_buf = NULL;
+    memset(&tracker->_stage_times, 0, sizeof(TldStageTimes));
     // Add zeroing/init for the rest as needed
 }
 
+static void tld_tracker_stop_track_worker(TldTracker* tracker);
+
+void tld_tracker_free(TldTracker* tracker) {
+    tld_tracker_stop_track_worker(tracker);
+    opt_flow_tracker_free(&tracker->_tracker);
+    frame_cache_free(&tracker->_frames);
+    frame_ring_free(&tracker->_ring);
+}
+
+static double tld_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec * 1e-3;
+}
+
+static void tld_tracker_track(TldTracker* tracker) {
+    double start = tld_now_us();
+    tracker->_tracker_proposal = opt_flow_tracker_track(&tracker->_tracker);
+    tracker->_stage_times.track_us = tld_now_us() - start;
+}
+
+// Track worker of the concurrent mode. A frame's job touches only _tracker,
+// _tracker_proposal and the track time.
+static void* tld_tracker_track_worker(void* arg) {
+    TldTracker* tracker = (TldTracker*)arg;
+    pthread_mutex_lock(&tracker->_track_lock);
+    while (1) {
+        while (!tracker->_track_pending && !tracker->_track_stop)
+            pthread_cond_wait(&tracker->_track_requested, &tracker->_track_lock);
+        if (tracker->_track_stop)
+            break;
+        pthread_mutex_unlock(&tracker->_track_lock);
+        tld_tracker_track(tracker);
+        pthread_mutex_lock(&tracker->_track_lock);
+        tracker->_track_pending = 0;
+        pthread_cond_signal(&tracker->_track_finished);
+    }
+    pthread_mutex_unlock(&tracker->_track_lock);
+    return NULL;
+}
+
+static int tld_tracker_start_track_worker(TldTracker* tracker) {
+    if (tracker->_track_worker_running)
+        return 1;
+    pthread_mutex_init(&tracker->_track_lock, NULL);
+    pthread_cond_init(&tracker->_track_requested, NULL);
+    pthread_cond_init(&tracker->_track_finished, NULL);
+    tracker->_track_pending = 0;
+    tracker->_track_stop = 0;
+    if (pthread_create(&tracker->_track_worker, NULL, tld_tracker_track_worker, tracker) != 0) {
+        pthread_cond_destroy(&tracker->_track_finished);
+        pthread_cond_destroy(&tracker->_track_requested);
+        pthread_mutex_destroy(&tracker->_track_lock);
+        return 0;
+    }
+    tracker->_track_worker_running = 1;
+    return 1;
+}
+
+static void tld_tracker_stop_track_worker(TldTracker* tracker) {
+    if (!tracker->_track_worker_running)
+        return;
+    pthread_mutex_lock(&tracker->_track_lock);
+    tracker->_track_stop = 1;
+    pthread_cond_signal(&tracker->_track_requested);
+    pthread_mutex_unlock(&tracker->_track_lock);
+    pthread_join(tracker->_track_worker, NULL);
+    pthread_cond_destroy(&tracker->_track_finished);
+    pthread_cond_destroy(&tracker->_track_requested);
+    pthread_mutex_destroy(&tracker->_track_lock);
+    tracker->_track_worker_running = 0;
+}
+
+static void tld_tracker_track_async(TldTracker* tracker) {
+    pthread_mutex_lock(&tracker->_track_lock);
+    tracker->_track_pending = 1;
+    pthread_cond_signal(&tracker->_track_requested);
+    pthread_mutex_unlock(&tracker->_track_lock);
+}
+
+static void tld_tracker_track_wait(TldTracker* tracker) {
+    pthread_mutex_lock(&tracker->_track_lock);
+    while (tracker->_track_pending)
+        pthread_cond_wait(&tracker->_track_finished, &tracker->_track_lock);
+    pthread_mutex_unlock(&tracker->_track_lock);
+}
+
+static Candidate tld_tracker_process_buffer(TldTracker* tracker, FrameBuffer* buf);
+
+// Frame to decode the next input into. Passing it to tld_tracker_process_frame
+// hands it back without a copy.
+Image* tld_tracker_acquire_frame(TldTracker* tracker, int width, int height) {
+    frame_buffer_release(tracker->_lent_buf);
+    tracker->_lent_buf = frame_ring_acquire(&tracker->_ring, width, height);
+    return tracker->_lent_buf ? &tracker->_lent_buf->img : NULL;
+}
+
+// Frames from tld_tracker_acquire_frame are taken as is, others are copied
+// into a ring buffer (no allocation once the ring is warm)
 Candidate tld_tracker_process_frame(TldTracker* tracker, const Image* input_frame) {
-    // Clone source frame
-    image_clone(input_frame, &tracker->_src_frame);
+    FrameBuffer* buf = tracker->_lent_buf;
+    if (buf && buf->img.data == input_frame->data) {
+        tracker->_lent_buf = NULL;
+    } else {
+        buf = frame_ring_acquire(&tracker->_ring, input_frame->width, input_frame->height);
+        if (!buf) {
+            fprintf(stderr, "TLD tracker: no free frame buffer\n");
+            return tracker->_prediction;
+        }
+        for (int y = 0; y < input_frame->height; ++y)
+            memcpy(image_row(&buf->img, y), image_row(input_frame, y), input_frame->width);
+    }
+    return tld_tracker_process_buffer(tracker, buf);
+}
 
-    // Blur for low-frequency frame
-    blur_image(&tracker->_src_frame, &tracker->_lf_frame, 7); // 7x7 kernel
+// No copy: the caller keeps the pixels valid and unchanged until the next
+// process call returns, as the previous frame is still in use then
+Candidate tld_tracker_process_frame_borrowed(TldTracker* tracker, const Image* input_frame) {
+    FrameBuffer* buf = frame_ring_wrap(&tracker->_ring, input_frame);
+    if (!buf) {
+        fprintf(stderr, "TLD tracker: no free frame buffer\n");
+        return tracker->_prediction;
+    }
+    return tld_tracker_process_buffer(tracker, buf);
+}
 
-    // Set frames for detector/model/tracker
-    object_detector_set_frame(&tracker->_detector, &tracker->_lf_frame);
-    object_model_set_frame(&tracker->_model, &tracker->_src_frame);
-    opt_flow_tracker_set_frame(&tracker->_tracker, &tracker->_src_frame);
+static Candidate tld_tracker_process_buffer_timed(TldTracker* tracker, FrameBuffer* buf);
 
+static Candidate tld_tracker_process_buffer(TldTracker* tracker, FrameBuffer* buf) {
+    double start = tld_now_us();
+    memset(&tracker->_stage_times, 0, sizeof(TldStageTimes));
+    Candidate result = tld_tracker_process_buffer_timed(tracker, buf);
+    tracker->_stage_times.total_us = tld_now_us() - start;
+    return result;
+}
+
+static Candidate tld_tracker_process_buffer_timed(TldTracker* tracker, FrameBuffer* buf) {
+    TldStageTimes* times = &tracker->_stage_times;
+    double stage_start;
+    // Takes over the reference of buf. The frame before the previous one is no
+    // longer referred to by anything.
+    frame_buffer_release(tracker->_prev_buf);
+    tracker->_prev_buf = tracker->_cur_buf;
+    tracker->_cur_buf = buf;
+    Image* frame = &buf->img;
+    // Borrowed frames come with whatever border the caller gave them
+    if (frame->data == buf->storage.data)
+        image_replicate_border(frame);
+
+    // Set frames for model/tracker. Nothing is computed here: the blurred frame,
+    // its integrals and the pyramids are built by whoever needs them first.
+    frame_cache_set_frame(&tracker->_frames, frame);
+    object_model_set_frame(&tracker->_model, frame);
+    opt_flow_tracker_set_frame(&tracker->_tracker, frame);
+
+    // Proposals and clusters describe the current frame only: frames that
+    // skip detection (fast path, tracking stopped) report none
+    tracker->_fast_path_active = 0;
+    tracker->_detector_proposals.count = 0;
+    tracker->_integrator.detector_proposal_clusters_count = 0;
     if (tracker->_processing_en) {
+        int tracked = 0;
+
+        // Fast path: the integrator has confirmed the tracker for a while, so only
+        // track and check the result by the model until the next verification frame
+        if (tracker->_fast_path_en &&
+            tracker->_stable_frames_cnt >= tracker->_fast_path_enter_frames &&
+            tracker->_fast_path_frames_cnt < tracker->_fast_path_verify_period) {
+            tld_tracker_track(tracker);
+            tracked = 1;
+            if (tracker->_tracker_proposal.valid &&
+                tracker->_tracker_proposal.prob >= tracker->_fast_path_min_tracker_prob) {
+                stage_start = tld_now_us();
+                double model_prob = object_model_predict_candidate(&tracker->_model, tracker->_tracker_proposal);
+                times->verify_us = tld_now_us() - stage_start;
+                if (model_prob >= tracker->_fast_path_min_model_prob) {
+                    tracker->_prediction = tracker->_tracker_proposal;
+                    tracker->_prediction.prob = model_prob;
+                    tracker->_prediction.aux_prob = model_prob;
+                    tracker->_training_en = 0;
+                    tracker->_tracker_relocate = 0;
+                    tracker->_fast_path_frames_cnt++;
+                    tracker->_fast_path_active = 1;
+                    opt_flow_tracker_set_target(&tracker->_tracker, tracker->_tracker_proposal.strobe);
+                    tracker->_prediction.src = PROPOSAL_SOURCE_FINAL;
+                    return tracker->_prediction;
+                }
+            }
+            // Tracker or model confidence dropped: verify right now
+            tracker->_stable_frames_cnt = 0;
+        }
+        tracker->_fast_path_frames_cnt = 0;
+        object_detector_set_frame(&tracker->_detector, frame_cache_lf_frame(&tracker->_frames));
+
+        // Detector and tracker do not read each other's output before integration,
+        // so in the concurrent mode the track worker runs meanwhile.
+        // Tracking is already done if the fast path fell through on this frame.
+        int track_async = !tracked && tracker->_parallel_en;
+        if (track_async)
+            tld_tracker_track_async(tracker);
+
         // Detect
+        stage_start = tld_now_us();
         CandidateArray detector_proposals = object_detector_detect(&tracker->_detector);
         candidate_array_free(&tracker->_detector_proposals);
         tracker->_detector_proposals = candidate_array_clone(&detector_proposals);
+        times->detect_us = tld_now_us() - stage_start;
 
         // Track
-        tracker->_tracker_proposal = opt_flow_tracker_track(&tracker->_tracker);
+        if (track_async)
+            tld_tracker_track_wait(tracker);
+        else if (!tracked)
+            tld_tracker_track(tracker);
 
         // Integrate (returns IntegratorResult)
+        stage_start = tld_now_us();
         IntegratorResult result = integrator_integrate(
             &tracker->_integrator,
             tracker->_detector_proposals.data, tracker->_detector_proposals.count,
@@ -73,17 +292,29 @@ Candidate tld_tracker_process_frame(TldTracker* tracker, const Image* input_fram
         tracker->_prediction = result.candidate;
         tracker->_training_en = result.training_enable;
         tracker->_tracker_relocate = result.tracker_relocation_enable;
+        if (integrator_tracker_confirmed(&tracker->_integrator))
+            tracker->_stable_frames_cnt++;
+        else
+            tracker->_stable_frames_cnt = 0;
+        times->verify_us += tracker->_integrator.verification_us;
+        times->integrate_us = tld_now_us() - stage_start - tracker->_integrator.verification_us;
 
-        // Training and relocation
+        // Training and relocation. Both learners gate themselves on novelty, so
+        // steady-tracking frames usually end up here without an update.
+        stage_start = tld_now_us();
         if (tracker->_training_en) {
-            object_detector_train(&tracker->_detector, tracker->_prediction);
+            object_detector_set_integral(&tracker->_detector, frame_cache_lf_integral(&tracker->_frames));
+            int det_trained = object_detector_train(&tracker->_detector, tracker->_prediction);
             object_detector_update_grid(&tracker->_detector, tracker->_prediction);
-            object_model_train(&tracker->_model, tracker->_prediction);
+            int model_trained = object_model_train(&tracker->_model, tracker->_prediction);
+            if (!det_trained && !model_trained)
+                tracker->_training_skipped_cnt++;
         }
         if (tracker->_tracker_relocate)
             opt_flow_tracker_set_target(&tracker->_tracker, tracker->_prediction.strobe);
         else
             opt_flow_tracker_set_target(&tracker->_tracker, tracker->_tracker_proposal.strobe);
+        times->learn_us = tld_now_us() - stage_start;
     }
 
     tracker->_prediction.src = PROPOSAL_SOURCE_FINAL;
@@ -93,17 +324,61 @@ Candidate tld_tracker_process_frame(TldTracker* tracker, const Image* input_fram
 Candidate tld_tracker_get_current_prediction(const TldTracker* tracker) {
     return tracker->_prediction;
 }
+// The arrays are views of the tracker's state, valid until the next frame
+CandidateArray tld_tracker_get_detector_proposals(const TldTracker* tracker) {
+    return tracker->_detector_proposals;
+}
+CandidateArray tld_tracker_get_clusters(const TldTracker* tracker) {
+    CandidateArray out;
+    out.data = (Candidate*)tracker->_integrator.detector_proposal_clusters;
+    out.count = (int)tracker->_integrator.detector_proposal_clusters_count;
+    out.capacity = MAX_CANDIDATES;
+    return out;
+}
+Candidate tld_tracker_get_tracker_proposal(const TldTracker* tracker) {
+    return tracker->_tracker_proposal;
+}
 Candidate tld_tracker_process_frame(TldTracker* tracker, const Image* input_frame);
 
 void tld_tracker_start_tracking(TldTracker* tracker, Rect target) {
+    object_detector_set_frame(&tracker->_detector, frame_cache_lf_frame(&tracker->_frames));
+    object_detector_set_integral(&tracker->_detector, frame_cache_lf_integral(&tracker->_frames));
     object_detector_set_target(&tracker->_detector, target);
     opt_flow_tracker_set_target(&tracker->_tracker, target);
     object_model_set_target(&tracker->_model, target);
     tracker->_processing_en = 1;
+    tracker->_stable_frames_cnt = 0;
+    tracker->_fast_path_frames_cnt = 0;
 }
 void tld_tracker_stop_tracking(TldTracker* tracker) {
     tracker->_processing_en = 0;
 }
+void tld_tracker_set_fast_path(TldTracker* tracker, int enable, int enter_frames, int verify_period) {
+    tracker->_fast_path_en = enable;
+    tracker->_fast_path_enter_frames = enter_frames;
+    tracker->_fast_path_verify_period = verify_period;
+    tracker->_stable_frames_cnt = 0;
+    tracker->_fast_path_frames_cnt = 0;
+}
+// Takes effect as buffers are next reallocated. Refused while tracking: the
+// detector grids hold pixel offsets for the current lf-frame stride.
+int tld_tracker_set_frame_border(TldTracker* tracker, int border) {
+    if (tracker->_processing_en)
+        return 0;
+    tracker->_ring.border = border;
+    tracker->_frames.border = border;
+    // Drops the current frame's blur, so a start_tracking on this very frame
+    // already sets the grids up for the new stride
+    frame_cache_set_frame(&tracker->_frames, tracker->_frames.frame);
+    return 1;
+}
+void tld_tracker_set_parallel(TldTracker* tracker, int enable) {
+    if (enable)
+        enable = tld_tracker_start_track_worker(tracker);
+    else
+        tld_tracker_stop_track_worker(tracker);
+    tracker->_parallel_en = enable;
+}
 void tld_tracker_update_settings(TldTracker* tracker) {
     // No-op
 }
@@ -119,15 +394,22 @@ void tld_tracker_get_proposals(const TldTracker* tracker, CandidateArray* detect
     // Return tracker proposal
     *tracker_proposal = tracker->_tracker_proposal;
 }
+TldStageTimes tld_tracker_get_stage_times(const TldTracker* tracker) {
+    return tracker->_stage_times;
+}
 TldStatus tld_tracker_get_status(const TldTracker* tracker) {
     TldStatus out;
-    out.message = integrator_get_status_message(&(tracker->_integrator));
+    out.message = tracker->_fast_path_active ? "Fast path: tracker verified by the model"
+                                             : integrator_get_status_message(&(tracker->_integrator));
     out.training = tracker->_training_en;
+    out.training_skipped_cnt = tracker->_training_skipped_cnt;
     out.processing = tracker->_processing_en;
+    out.fast_path = tracker->_fast_path_active;
     out.valid_object = tracker->_prediction.valid;
     out.tracker_relocation = tracker->_tracker_relocate;
     out.detector_candidates_cnt = tracker->_detector_proposals.count;
-    out.detector_clusters_cnt = integrator_get_clusters(&(tracker->_integrator)).count;
+    out.detector_clusters_cnt = tld_tracker_get_clusters(tracker).count;
+    out.active_ferns_cnt = object_detector_get_active_ferns_cnt(&tracker->_detector);
     return out;
 }
 void tld_tracker_get_models_positive(const TldTracker* tracker, Image* out_array, int* out_count) {
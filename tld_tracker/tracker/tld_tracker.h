@@ -6,18 +6,39 @@
 #include "object_model.h"
 #include "opt_flow_tracker.h"
 #include "integrator.h"
+#include "frame_cache.h"
+#include "frame_ring.h"
+#include <pthread.h>
+
+// Replicated border around the frames the tracker owns, in pixels. Warps of
+// boxes sticking out of the frame by less than this run without clamping.
+#define TLD_FRAME_BORDER 16
 
 // Example struct for TldStatus
 typedef struct {
     const char* message;
     int training;
+    int training_skipped_cnt;
     int processing;
+    int fast_path;
     int valid_object;
     int tracker_relocation;
     int detector_candidates_cnt;
     int detector_clusters_cnt;
+    int active_ferns_cnt;
 } TldStatus;
 
+// Wall time of the stages of the last processed frame, in microseconds; 0 for
+// stages that did not run. In the concurrent mode track overlaps detect.
+typedef struct {
+    double track_us;
+    double verify_us;       // model checks: fast path and verification of clusters
+    double detect_us;
+    double integrate_us;    // decision, without its verify_us share
+    double learn_us;        // training and tracker relocation
+    double total_us;
+} TldStageTimes;
+
 // Example: dynamic array for Candidate
 typedef struct {
     Candidate* data;
@@ -30,23 +51,59 @@ typedef struct {
     int _processing_en;
     Candidate _prediction;
     int _training_en;
+    int _training_skipped_cnt;
     int _tracker_relocate;
+    // Tracker-only fast path: entered after _fast_path_enter_frames frames the
+    // integrator confirmed the tracker, left for a full cycle every
+    // _fast_path_verify_period frames or as soon as confidence drops
+    int _fast_path_en;
+    int _fast_path_enter_frames;
+    int _fast_path_verify_period;
+    double _fast_path_min_tracker_prob;
+    double _fast_path_min_model_prob;
+    int _stable_frames_cnt;
+    int _fast_path_frames_cnt;
+    int _fast_path_active;
+    int _parallel_en;       // detect and track on two threads
+    // Track worker of the concurrent mode, kept from tld_tracker_set_parallel
+    // until the mode is switched off or the tracker is freed
+    int _track_worker_running;
+    pthread_t _track_worker;
+    pthread_mutex_t _track_lock;
+    pthread_cond_t _track_requested;
+    pthread_cond_t _track_finished;
+    int _track_pending;     // frame handed to the worker, not tracked yet
+    int _track_stop;
     CandidateArray _detector_proposals;
     Candidate _tracker_proposal;
     ObjectDetector _detector;
     ObjectModel _model;
     OptFlowTracker _tracker;
     Integrator _integrator;
-    Image _src_frame;
-    Image _lf_frame;
+    // Frames are held by reference: the current one, the previous one (the
+    // tracker's previous pyramid refers to it) and one lent out to be filled
+    FrameRing _ring;
+    FrameBuffer* _cur_buf;
+    FrameBuffer* _prev_buf;
+    FrameBuffer* _lent_buf;
+    FrameCache _frames;     // blurred frame and its integrals, on demand
+    TldStageTimes _stage_times;
 } TldTracker;
 
 void tld_tracker_init(TldTracker* tracker, Settings settings);
 void tld_tracker_free(TldTracker* tracker);
 Candidate tld_tracker_process_frame(TldTracker* tracker, const Image* input_frame);
+Candidate tld_tracker_process_frame_borrowed(TldTracker* tracker, const Image* input_frame);
+Image* tld_tracker_acquire_frame(TldTracker* tracker, int width, int height);
+// Returns 0 (and changes nothing) while tracking
+int tld_tracker_set_frame_border(TldTracker* tracker, int border);
 void tld_tracker_start_tracking(TldTracker* tracker, Rect target);
 void tld_tracker_stop_tracking(TldTracker* tracker);
+void tld_tracker_set_fast_path(TldTracker* tracker, int enable, int enter_frames, int verify_period);
+// Starts or stops the track worker; the tracker must stay in place while it runs
+void tld_tracker_set_parallel(TldTracker* tracker, int enable);
 TldStatus tld_tracker_get_status(const TldTracker* tracker);
+TldStageTimes tld_tracker_get_stage_times(const TldTracker* tracker);
 CandidateArray tld_tracker_get_detector_proposals(const TldTracker* tracker);
 CandidateArray tld_tracker_get_clusters(const TldTracker* tracker);
 Candidate tld_tracker_get_tracker_proposal(const TldTracker* tracker);
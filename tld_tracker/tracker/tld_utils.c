@@ -33,6 +33,8 @@ Image generate_random_image() {
     Image out;
     out.width = width;
     out.height = height;
+    out.stride = width;
+    out.border = 0;
     out.data = (uint8_t*)malloc(width * height);
     if (!out.data) { out.width = 0; out.height = 0; }
     for (int j = 0; j < height; j++)
@@ -45,6 +47,8 @@ Image generate_random_image_with_size(int width, int height) {
     Image out;
     out.width = width;
     out.height = height;
+    out.stride = width;
+    out.border = 0;
     out.data = (uint8_t*)malloc(width * height);
     if (!out.data) { out.width = 0; out.height = 0; }
     for (int j = 0; j < height; j++)
@@ -53,9 +57,63 @@ Image generate_random_image_with_size(int width, int height) {
     return out;
 }
 
+static int align_up(int value, int alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// Padded images keep the allocation start implied by the layout: border rows
+// above data, and the left border rounded up to keep data aligned
+static uint8_t* image_allocation(const Image* img) {
+    if (img->border <= 0)
+        return img->data;
+    return img->data - (size_t)img->border * img->stride - align_up(img->border, IMAGE_ROW_ALIGN);
+}
+
 void image_free(Image* img) {
-    if (img && img->data) free(img->data);
+    if (img && img->data) free(image_allocation(img));
     img->data = NULL;
+    img->border = 0;
+}
+
+Image image_create_padded(int width, int height, int border) {
+    if (border <= 0)
+        return image_create(width, height);
+    Image img;
+    int left = align_up(border, IMAGE_ROW_ALIGN);
+    img.width = width;
+    img.height = height;
+    img.border = border;
+    img.stride = align_up(left + width + border, IMAGE_ROW_ALIGN);
+    size_t size = (size_t)img.stride * (height + 2 * border);
+    uint8_t* base = (uint8_t*)aligned_alloc(IMAGE_ROW_ALIGN, size);
+    if (!base) {
+        img.width = 0;
+        img.height = 0;
+        img.border = 0;
+        img.data = NULL;
+        return img;
+    }
+    img.data = base + (size_t)border * img.stride + left;
+    return img;
+}
+
+// Costs O(border * (width + height)), not a pass over the image
+void image_replicate_border(Image* img) {
+    int b = img->border;
+    if (b <= 0 || img->width <= 0 || img->height <= 0)
+        return;
+    for (int y = 0; y < img->height; ++y) {
+        uint8_t* row = image_row(img, y);
+        memset(row - b, row[0], b);
+        memset(row + img->width, row[img->width - 1], b);
+    }
+    size_t span = (size_t)img->width + 2 * b;
+    const uint8_t* top = image_row(img, 0) - b;
+    const uint8_t* bottom = image_row(img, img->height - 1) - b;
+    for (int k = 1; k <= b; ++k) {
+        memcpy(image_row(img, -k) - b, top, span);
+        memcpy(image_row(img, img->height - 1 + k) - b, bottom, span);
+    }
 }
 
 Rect get_extended_rect_for_rotation(Rect base_rect, double angle_degrees) {
@@ -74,6 +132,8 @@ Image image_create(int width, int height) {
     Image img;
     img.width = width;
     img.height = height;
+    img.stride = width;
+    img.border = 0;
     img.data = (uint8_t*)malloc(width * height);
     if (!img.data) { img.width = 0; img.height = 0; }
     return img;
@@ -81,7 +141,7 @@ Image image_create(int width, int height) {
 
 Image image_crop(const Image* src, Rect roi) {
     Image out = *src;
-    out.data = src->data + roi.y * src->width + roi.x;
+    out.data = src->data + (size_t)roi.y * src->stride + roi.x;
     out.width = roi.width;
     out.height = roi.height;
     return out;
@@ -90,8 +150,8 @@ Image image_crop(const Image* src, Rect roi) {
 void image_copy_region(const Image* src, Image* dst, int x0, int y0) {
     for (int j = 0; j < src->height; j++) {
         for (int i = 0; i < src->width; i++) {
-            int di = (y0 + j) * dst->width + (x0 + i);
-            int si = j * src->width + i;
+            size_t di = (size_t)(y0 + j) * dst->stride + (x0 + i);
+            size_t si = (size_t)j * src->stride + i;
             dst->data[di] = src->data[si];
         }
     }
@@ -105,21 +165,22 @@ Size image_size(const Image* img) {
 }
 
 // --- MISSING image_subframe_clone ---
+// Parts of roi outside src are zero; the inside is copied row by row
 Image image_subframe_clone(const Image* src, Rect roi) {
-    Image sub;
-    sub.width = roi.width;
-    sub.height = roi.height;
-    sub.data = malloc(sub.width * sub.height);
+    Image sub = image_create(roi.width, roi.height);
+    if (!sub.data) return sub;
+    int x0 = roi.x < 0 ? 0 : roi.x;
+    int x1 = roi.x + roi.width > src->width ? src->width : roi.x + roi.width;
     for (int y = 0; y < roi.height; ++y) {
-        for (int x = 0; x < roi.width; ++x) {
-            int src_x = roi.x + x;
-            int src_y = roi.y + y;
-            if (src_x >= 0 && src_x < src->width && src_y >= 0 && src_y < src->height) {
-                sub.data[y * sub.width + x] = src->data[src_y * src->width + src_x];
-            } else {
-                sub.data[y * sub.width + x] = 0;
-            }
+        uint8_t* dst_row = image_row(&sub, y);
+        int src_y = roi.y + y;
+        if (src_y < 0 || src_y >= src->height || x0 >= x1) {
+            memset(dst_row, 0, sub.width);
+            continue;
         }
+        memset(dst_row, 0, x0 - roi.x);
+        memcpy(dst_row + (x0 - roi.x), image_row(src, src_y) + x0, x1 - x0);
+        memset(dst_row + (x1 - roi.x), 0, roi.x + roi.width - x1);
     }
     return sub;
 }
@@ -136,9 +197,9 @@ void image_rotate(const Image* src, Image* dst, double angle_deg, double cx, dou
             int src_x = (int)round(sx);
             int src_y = (int)round(sy);
             if (src_x >= 0 && src_x < src->width && src_y >= 0 && src_y < src->height)
-                dst->data[y * dst->width + x] = src->data[src_y * src->width + src_x];
+                dst->data[y * dst->stride + x] = src->data[src_y * src->stride + src_x];
             else
-                dst->data[y * dst->width + x] = 0;
+                dst->data[y * dst->stride + x] = 0;
         }
     }
 }
@@ -152,7 +213,7 @@ Image get_rotated_subframe(const Image* frame, Rect subframe_rect, double angle_
             int fy = ext.y + j;
             src_subframe.data[j * ext.width + i] =
                 (fx >= 0 && fx < frame->width && fy >= 0 && fy < frame->height)
-                ? frame->data[fy * frame->width + fx]
+                ? frame->data[fy * frame->stride + fx]
                 : 0;
         }
     Image rotated = image_create(ext.width, ext.height);
@@ -178,7 +239,7 @@ void rotate_subframe(Image* frame, Rect subframe_rect, double angle_deg) {
             int fy = ext.y + j;
             src_subframe.data[j * ext.width + i] =
                 (fx >= 0 && fx < frame->width && fy >= 0 && fy < frame->height)
-                ? frame->data[fy * frame->width + fx]
+                ? frame->data[fy * frame->stride + fx]
                 : 0;
         }
     Image rotated = image_create(ext.width, ext.height);
@@ -191,7 +252,7 @@ void rotate_subframe(Image* frame, Rect subframe_rect, double angle_deg) {
         for (int i = 0; i < subframe_rect.width; i++) {
             int fx = subframe_rect.x + i;
             if (fx < 0 || fx >= frame->width) continue;
-            frame->data[fy * frame->width + fx] =
+            frame->data[fy * frame->stride + fx] =
                 rotated.data[(offset_y + j) * ext.width + (offset_x + i)];
         }
     }
@@ -199,22 +260,31 @@ void rotate_subframe(Image* frame, Rect subframe_rect, double angle_deg) {
     image_free(&rotated);
 }
 
+// Interpolation between the four pixels at p (stride apart), no checks
+static inline uint8_t bilinear_unchecked(const uint8_t* p, int stride, double dx, double dy) {
+    double p1 = p[0] + dx * (p[1] - p[0]);
+    double p2 = p[stride] + dx * (p[stride + 1] - p[stride]);
+    return (uint8_t)(p1 + dy * (p2 - p1));
+}
+
+// Out-of-image points take the nearest edge value, as a replicated border would
 uint8_t bilinear_interp_for_point(double x, double y, const Image* img) {
     int image_x_size = img->width;
     int image_y_size = img->height;
+    int stride = img->stride;
     uint8_t* data = img->data;
     if (x < 0.0) x = 0.0;
-    if (x > image_x_size - 2) x = image_x_size - 2;
+    if (x > image_x_size - 1) x = image_x_size - 1;
     if (y < 0.0) y = 0.0;
-    if (y > image_y_size - 2) y = image_y_size - 2;
+    if (y > image_y_size - 1) y = image_y_size - 1;
     int x1 = (int)x;
-    int x2 = x1 + 1;
+    int x2 = x1 + 1 < image_x_size ? x1 + 1 : x1;
     int y1 = (int)y;
-    int y2 = y1 + 1;
-    int Ix1y1 = data[y1 * image_x_size + x1];
-    int Ix2y1 = data[y1 * image_x_size + x2];
-    int Ix1y2 = data[y2 * image_x_size + x1];
-    int Ix2y2 = data[y2 * image_x_size + x2];
+    int y2 = y1 + 1 < image_y_size ? y1 + 1 : y1;
+    int Ix1y1 = data[y1 * stride + x1];
+    int Ix2y1 = data[y1 * stride + x2];
+    int Ix1y2 = data[y2 * stride + x1];
+    int Ix2y2 = data[y2 * stride + x2];
     double dx = x - x1;
     double dy = y - y1;
     double p1 = Ix1y1 + dx * (Ix2y1 - Ix1y1);
@@ -241,6 +311,8 @@ void subframe_linear_transform(const Image* frame, Rect in_strobe, double angle,
     Rect strobe = adjust_rect_to_frame(in_strobe, (Size){frame->width, frame->height});
     out->width = strobe.width;
     out->height = strobe.height;
+    out->stride = strobe.width;
+    out->border = 0;
     out->data = (uint8_t*)malloc(out->width * out->height);
     if (!out->data) { out->width = 0; out->height = 0; return; }
     angle = degree2rad(angle);
@@ -248,30 +320,47 @@ void subframe_linear_transform(const Image* frame, Rect in_strobe, double angle,
     int central_y_pix = strobe.y + strobe.height / 2;
     int offs_x = strobe.x - central_x_pix;
     int offs_y = strobe.y - central_y_pix;
-    double x_scaled, y_scaled, snan, csan, x_rotated, y_rotated;
+    double snan = 0.0, csan = 1.0;
+    if (fabs(angle) > 1e-9) {
+        snan = sin(angle);
+        csan = cos(angle);
+    }
+    // Source point of output pixel (i, j): scale about the strobe center, rotate
+    // about it, then shift
+    #define WARP_X(i, j) (((offs_x + (i)) * csan + (offs_y + (j)) * snan) / scale + central_x_pix - offset_x)
+    #define WARP_Y(i, j) ((-(offs_x + (i)) * snan + (offs_y + (j)) * csan) / scale + central_y_pix - offset_y)
+
+    // The map is affine, so the corners bound every sample. If they all fall
+    // within the image and its border no pixel needs clamping.
+    int last_i = strobe.width - 1, last_j = strobe.height - 1;
+    double xs[4] = { WARP_X(0, 0), WARP_X(last_i, 0), WARP_X(0, last_j), WARP_X(last_i, last_j) };
+    double ys[4] = { WARP_Y(0, 0), WARP_Y(last_i, 0), WARP_Y(0, last_j), WARP_Y(last_i, last_j) };
+    double min_x = xs[0], max_x = xs[0], min_y = ys[0], max_y = ys[0];
+    for (int k = 1; k < 4; ++k) {
+        if (xs[k] < min_x) min_x = xs[k];
+        if (xs[k] > max_x) max_x = xs[k];
+        if (ys[k] < min_y) min_y = ys[k];
+        if (ys[k] > max_y) max_y = ys[k];
+    }
+    const double eps = 1e-6;
+    int unchecked = min_x >= -frame->border + eps && max_x <= frame->width - 1 + frame->border - 1 - eps &&
+                    min_y >= -frame->border + eps && max_y <= frame->height - 1 + frame->border - 1 - eps;
+
     for (int j = 0; j < strobe.height; ++j) {
-        for (int i = 0; i < strobe.width; ++i) {
-            if (scale != 1.0) {
-                x_scaled = (offs_x + i) / scale + central_x_pix;
-                y_scaled = (offs_y + j) / scale + central_y_pix;
-            } else {
-                x_scaled = strobe.x + i;
-                y_scaled = strobe.y + j;
+        uint8_t* dst = out->data + j * strobe.width;
+        if (unchecked) {
+            for (int i = 0; i < strobe.width; ++i) {
+                double x = WARP_X(i, j), y = WARP_Y(i, j);
+                int x1 = (int)floor(x), y1 = (int)floor(y);
+                dst[i] = bilinear_unchecked(image_row(frame, y1) + x1, frame->stride, x - x1, y - y1);
             }
-            if (fabs(angle) > 1e-9) {
-                snan = sin(angle);
-                csan = cos(angle);
-                x_rotated = (x_scaled - central_x_pix) * csan + (y_scaled - central_y_pix) * snan + central_x_pix;
-                y_rotated = (-1) * (x_scaled - central_x_pix) * snan + (y_scaled - central_y_pix) * csan + central_y_pix;
-            } else {
-                x_rotated = x_scaled;
-                y_rotated = y_scaled;
-            }
-            x_rotated = x_rotated - offset_x;
-            y_rotated = y_rotated - offset_y;
-            out->data[j * strobe.width + i] = bilinear_interp_for_point(x_rotated, y_rotated, frame);
+        } else {
+            for (int i = 0; i < strobe.width; ++i)
+                dst[i] = bilinear_interp_for_point(WARP_X(i, j), WARP_Y(i, j), frame);
         }
     }
+    #undef WARP_X
+    #undef WARP_Y
 }
 
 double compute_iou(Rect a, Rect b) {
@@ -304,38 +393,124 @@ Point2f get_mean_shift(const Point2f* start, const Point2f* stop, size_t count)
     return acc;
 }
 
-static double point2f_dist(Point2f a, Point2f b) {
-    double dx = a.x - b.x;
-    double dy = a.y - b.y;
-    return sqrt(dx*dx + dy*dy);
+// k-th smallest value (quickselect), reorders the array
+float select_kth(float* values, size_t count, size_t k) {
+    size_t lo = 0, hi = count - 1;
+    while (lo < hi) {
+        float pivot = values[lo + (hi - lo) / 2];
+        size_t i = lo, j = hi;
+        while (i <= j) {
+            while (values[i] < pivot) ++i;
+            while (values[j] > pivot) --j;
+            if (i <= j) {
+                float tmp = values[i];
+                values[i] = values[j];
+                values[j] = tmp;
+                ++i;
+                if (j == 0) break;
+                --j;
+            }
+        }
+        if (k <= j) hi = j;
+        else if (k >= i) lo = i;
+        else break;
+    }
+    return values[k];
+}
+
+static float* median_flow_reserve(MedianFlowScratch* scratch, size_t size) {
+    if (scratch->capacity < size) {
+        free(scratch->buffer);
+        scratch->buffer = (float*)malloc(sizeof(float) * size);
+        scratch->capacity = scratch->buffer ? size : 0;
+    }
+    return scratch->buffer;
 }
 
-static int compare_double(const void* a, const void* b) {
-    double da = *(const double*)a;
-    double db = *(const double*)b;
-    return (da > db) - (da < db);
+void median_flow_scratch_free(MedianFlowScratch* scratch) {
+    free(scratch->buffer);
+    scratch->buffer = NULL;
+    scratch->capacity = 0;
 }
 
-double get_scale(const Point2f* start, const Point2f* stop, size_t count) {
-    size_t max_samples = count * (count - 1) / 2;
-    double* scale_sample = malloc(max_samples * sizeof(double));
-    size_t idx = 0;
-    for (size_t i = 0; i < count; i++) {
-        for (size_t j = i + 1; j < count; j++) {
-            double dist_prev = point2f_dist(start[i], start[j]);
-            double dist_cur  = point2f_dist(stop[i], stop[j]);
-            if (dist_prev > 1e-8)
-                scale_sample[idx++] = sqrt((dist_cur * dist_cur) / (dist_prev * dist_prev));
+Point2f get_median_shift(const Point2f* start, const Point2f* stop, size_t count, MedianFlowScratch* scratch) {
+    Point2f out = {0.0f, 0.0f};
+    if (count == 0) return out;
+    float* dx = median_flow_reserve(scratch, 2 * count);
+    if (!dx) return get_mean_shift(start, stop, count);
+    float* dy = dx + count;
+    for (size_t i = 0; i < count; ++i) {
+        dx[i] = stop[i].x - start[i].x;
+        dy[i] = stop[i].y - start[i].y;
+    }
+    out.x = select_kth(dx, count, count / 2);
+    out.y = select_kth(dy, count, count / 2);
+    return out;
+}
+
+// Median of the pairwise distance ratios. Squared ratios are used (sqrt is monotonic,
+// so it is taken once on the median), and points are split into coordinate arrays
+// so the inner loop over the second point of a pair vectorizes.
+double get_median_scale(const Point2f* start, const Point2f* stop, size_t count, MedianFlowScratch* scratch) {
+    if (count < 2) return 1.0;
+    size_t all_pairs = count * (count - 1) / 2;
+    // Subsampling: pair every point with its next `span` neighbours (cyclically).
+    // Past (count - 1) / 2 neighbours the cyclic pairs repeat, so all pairs are used then.
+    size_t span = count - 1;
+    size_t pairs = all_pairs;
+    if (scratch->max_pairs && scratch->max_pairs < all_pairs) {
+        size_t sub_span = (scratch->max_pairs + count - 1) / count;
+        if (sub_span < 1) sub_span = 1;
+        if (sub_span <= (count - 1) / 2) {
+            span = sub_span;
+            pairs = span * count;
         }
     }
-    if (idx == 0) {
-        free(scale_sample);
-        return 1.0;
+    float* buf = median_flow_reserve(scratch, 5 * count + pairs);
+    if (!buf) return 1.0;
+    float* x0 = buf;
+    float* y0 = x0 + count;
+    float* x1 = y0 + count;
+    float* y1 = x1 + count;
+    float* ratio_row = y1 + count;
+    float* ratio = ratio_row + count;
+    for (size_t i = 0; i < count; ++i) {
+        x0[i] = start[i].x; y0[i] = start[i].y;
+        x1[i] = stop[i].x;  y1[i] = stop[i].y;
     }
-    qsort(scale_sample, idx, sizeof(double), compare_double);
-    double median = scale_sample[idx / 2];
-    free(scale_sample);
-    return median;
+
+    size_t idx = 0;
+    for (size_t i = 0; i < count; ++i) {
+        size_t first = i + 1;
+        size_t last = (span == count - 1) ? count : i + 1 + span;
+        for (size_t j0 = first; j0 < last; ) {
+            // Contiguous run of partners (wraps around once in subsampled mode)
+            size_t j_begin = j0 < count ? j0 : j0 - count;
+            size_t run = last - j0;
+            if (j_begin + run > count) run = count - j_begin;
+            for (size_t k = 0; k < run; ++k) {
+                size_t j = j_begin + k;
+                float pdx = x0[i] - x0[j], pdy = y0[i] - y0[j];
+                float cdx = x1[i] - x1[j], cdy = y1[i] - y1[j];
+                float prev2 = pdx * pdx + pdy * pdy;
+                float cur2 = cdx * cdx + cdy * cdy;
+                ratio_row[k] = prev2 > 1e-16f ? cur2 / prev2 : -1.0f;
+            }
+            for (size_t k = 0; k < run; ++k)
+                if (ratio_row[k] >= 0.0f)
+                    ratio[idx++] = ratio_row[k];
+            j0 += run;
+        }
+    }
+    if (idx == 0) return 1.0;
+    return sqrt((double)select_kth(ratio, idx, idx / 2));
+}
+
+double get_scale(const Point2f* start, const Point2f* stop, size_t count) {
+    MedianFlowScratch scratch = { NULL, 0, 0 };
+    double scale = get_median_scale(start, stop, count, &scratch);
+    median_flow_scratch_free(&scratch);
+    return scale;
 }
 
 void draw_candidate(Image* img, Candidate c) {
@@ -359,15 +534,15 @@ void draw_candidate(Image* img, Candidate c) {
     for (int t = 0; t < thickness; t++) {
         for (int x = x1 + t; x <= x2 - t; x++) {
             if (y1 + t >= 0 && y1 + t < img->height && x >= 0 && x < img->width)
-                img->data[(y1 + t) * img->width + x] = value;
+                img->data[(y1 + t) * img->stride + x] = value;
             if (y2 - t >= 0 && y2 - t < img->height && x >= 0 && x < img->width)
-                img->data[(y2 - t) * img->width + x] = value;
+                img->data[(y2 - t) * img->stride + x] = value;
         }
         for (int y = y1 + t; y <= y2 - t; y++) {
             if (x1 + t >= 0 && x1 + t < img->width && y >= 0 && y < img->height)
-                img->data[y * img->width + (x1 + t)] = value;
+                img->data[y * img->stride + (x1 + t)] = value;
             if (x2 - t >= 0 && x2 - t < img->width && y >= 0 && y < img->height)
-                img->data[y * img->width + (x2 - t)] = value;
+                img->data[y * img->stride + (x2 - t)] = value;
         }
     }
 }
@@ -395,26 +570,32 @@ void get_scan_position_cnt(Size frame_size, Size box, const double* scales, cons
 }
 
 double images_correlation(const Image* image_1, const Image* image_2) {
-    int n_pixels = image_1->width * image_1->height;
+    int w = image_1->width, h = image_1->height;
+    int n_pixels = w * h;
     double sum1 = 0.0, sum2 = 0.0;
     double sqsum1 = 0.0, sqsum2 = 0.0;
-    for (int i = 0; i < n_pixels; ++i) {
-        double v1 = (double)image_1->data[i];
-        double v2 = (double)image_2->data[i];
-        sum1 += v1;
-        sum2 += v2;
-        sqsum1 += v1 * v1;
-        sqsum2 += v2 * v2;
+    for (int y = 0; y < h; ++y) {
+        const uint8_t* r1 = image_row(image_1, y);
+        const uint8_t* r2 = image_row(image_2, y);
+        for (int x = 0; x < w; ++x) {
+            double v1 = (double)r1[x];
+            double v2 = (double)r2[x];
+            sum1 += v1;
+            sum2 += v2;
+            sqsum1 += v1 * v1;
+            sqsum2 += v2 * v2;
+        }
     }
     double mean1 = sum1 / n_pixels;
     double mean2 = sum2 / n_pixels;
     double std1 = sqrt(sqsum1 / n_pixels - mean1 * mean1);
     double std2 = sqrt(sqsum2 / n_pixels - mean2 * mean2);
     double covar = 0.0;
-    for (int i = 0; i < n_pixels; ++i) {
-        double v1 = (double)image_1->data[i] - mean1;
-        double v2 = (double)image_2->data[i] - mean2;
-        covar += v1 * v2;
+    for (int y = 0; y < h; ++y) {
+        const uint8_t* r1 = image_row(image_1, y);
+        const uint8_t* r2 = image_row(image_2, y);
+        for (int x = 0; x < w; ++x)
+            covar += ((double)r1[x] - mean1) * ((double)r2[x] - mean2);
     }
     covar /= n_pixels;
     double correl = covar / (std1 * std2 + 1e-12);
@@ -543,9 +724,9 @@ double get_frame_std_dev(const Image* frame, Rect roi) {
     double mean = 0.0, sum = 0.0, sqsum = 0.0;
     int count = 0;
     for (int j = roi.y; j < roi.y + roi.height; ++j) {
+        const uint8_t* row = image_row(frame, j);
         for (int i = roi.x; i < roi.x + roi.width; ++i) {
-            int idx = j * frame->width + i;
-            double v = (double)frame->data[idx];
+            double v = (double)row[i];
             sum += v;
             sqsum += v * v;
             ++count;
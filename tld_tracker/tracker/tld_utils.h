@@ -24,12 +24,19 @@ typedef struct {
     int src;
 } Candidate;
 
-// Raw grayscale image
+// Raw grayscale image. Rows are stride bytes apart (stride >= width), so an
+// image may be a view of a ROI, a decoder plane or a padded buffer. border
+// pixels around the image can be read as well: image_create_padded fills them
+// by replicating the edges, which lets kernels skip per-pixel bounds checks.
 typedef struct {
     int width, height;
+    int stride;
+    int border;
     uint8_t* data;
 } Image;
 
+#define IMAGE_ROW_ALIGN 64
+
 // Print a Rect
 void print_rect(FILE* out, const Rect* rect);
 
@@ -45,7 +52,13 @@ Image generate_random_image();
 Image generate_random_image_with_size(int width, int height);
 
 // Image memory
+Image image_create(int width, int height);
+// Rows (and data) aligned to IMAGE_ROW_ALIGN, with border pixels on each side
+Image image_create_padded(int width, int height, int border);
+void image_replicate_border(Image* img);
 void image_free(Image* img);
+// View of roi (inside src) sharing its pixels, no copy
+Image image_crop(const Image* src, Rect roi);
 
 // Rect utilities
 Rect get_extended_rect_for_rotation(Rect base_rect, double angle_degrees);
@@ -66,10 +79,22 @@ uint8_t bilinear_interp_for_point(double x, double y, const Image* img);
 double degree2rad(double angle);
 double rad2degree(double angle);
 
+// Reusable working memory of the median-flow estimator. max_pairs limits the
+// point pairs used for the scale (0 = all n*(n-1)/2 of them).
+typedef struct {
+    float* buffer;
+    size_t capacity;
+    size_t max_pairs;
+} MedianFlowScratch;
+
 // IOU, shifts, scale
 double compute_iou(Rect a, Rect b);
 Point2f get_mean_shift(const Point2f* start, const Point2f* stop, size_t count);
 double get_scale(const Point2f* start, const Point2f* stop, size_t count);
+float select_kth(float* values, size_t count, size_t k);
+Point2f get_median_shift(const Point2f* start, const Point2f* stop, size_t count, MedianFlowScratch* scratch);
+double get_median_scale(const Point2f* start, const Point2f* stop, size_t count, MedianFlowScratch* scratch);
+void median_flow_scratch_free(MedianFlowScratch* scratch);
 
 // Draw rectangles
 void draw_candidate(Image* img, Candidate c);
@@ -99,6 +124,10 @@ static inline Size image_size(const Image* img) {
     return sz;
 }
 
+static inline uint8_t* image_row(const Image* img, int y) {
+    return img->data + (ptrdiff_t)y * img->stride;
+}
+
 // Clone a subframe (rectangular region) from an image, returned as new Image
 Image image_subframe_clone(const Image* src, Rect roi);
 
@@ -1,5 +1,25 @@
 #include "unit_tests.h"
+#include "frame_source.h"
+#include "image_filter.h"
+#include "opt_flow_tracker.h"
+#include "pyr_lk.h"
+#include "shm_frame_ring.h"
+#include "spsc_queue.h"
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+static void check(int cond, const char* what) {
+    if (!cond) {
+        fprintf(stderr, "Assertion failed: %s\n", what);
+        exit(1);
+    }
+}
 
 void test_image_crop() {
     printf("Running test_image_crop...\n");
@@ -41,6 +61,370 @@ void test_fern_fext() {
     // TODO: Implement test logic for fern_fext
 }
 
+#define SHM_TEST_FRAMES 20000
+#define SHM_TEST_WIDTH 64
+#define SHM_TEST_HEIGHT 8
+
+// Blocking writer, as shm_frame_writer --block: retries a held slot instead of
+// dropping the frame. Every byte of frame i is i's low byte, the first eight
+// are i itself.
+static void* shm_test_writer(void* arg) {
+    ShmFrameRing* ring = (ShmFrameRing*)arg;
+    for (uint64_t i = 0; i < SHM_TEST_FRAMES; ++i) {
+        uint8_t* data;
+        while (!(data = shm_frame_ring_begin_write(ring)))
+            sched_yield();
+        for (int y = 0; y < SHM_TEST_HEIGHT; ++y)
+            memset(data + (size_t)y * ring->header->stride, (int)(i & 0xFF), SHM_TEST_WIDTH);
+        memcpy(data, &i, sizeof(i));
+        shm_frame_ring_commit(ring, (int64_t)i);
+    }
+    shm_frame_ring_finish(ring);
+    return NULL;
+}
+
+static uint64_t shm_test_frame_id(const Image* frame) {
+    uint64_t id;
+    memcpy(&id, frame->data, sizeof(id));
+    return id;
+}
+
+// Without drops the reader must see every frame once, in order and untorn,
+// and the previous frame must stay intact while the next one is in use
+void test_shm_frame_ring() {
+    printf("Running test_shm_frame_ring...\n");
+    const char* name = "/tld_unit_test_ring";
+    shm_unlink(name);
+    ShmFrameRing ring;
+    check(shm_frame_ring_create(&ring, name, SHM_TEST_WIDTH, SHM_TEST_HEIGHT, 4), "ring created");
+    FrameSource* src = frame_source_open_shm(name, 0, 5000);
+    check(src != NULL, "reader attached");
+    pthread_t writer;
+    pthread_create(&writer, NULL, shm_test_writer, &ring);
+
+    uint64_t expected = 0;
+    Image frame, prev;
+    int has_prev = 0;
+    while (frame_source_next(src, &frame) == 1) {
+        uint64_t id = shm_test_frame_id(&frame);
+        check(id == expected, "no gap in frame ids");
+        for (int y = 0; y < SHM_TEST_HEIGHT; ++y)
+            for (int x = y ? 0 : (int)sizeof(id); x < SHM_TEST_WIDTH; ++x)
+                check(image_row(&frame, y)[x] == (uint8_t)(id & 0xFF), "frame not torn");
+        if (has_prev)
+            check(shm_test_frame_id(&prev) == expected - 1, "previous frame kept");
+        prev = frame;
+        has_prev = 1;
+        expected++;
+    }
+    // Before joining: a writer blocked on a lost frame would never finish
+    check(expected == SHM_TEST_FRAMES, "all frames read");
+    pthread_join(writer, NULL);
+    check(atomic_load(&ring.header->dropped) == 0, "nothing dropped");
+    frame_source_close(src);
+    shm_frame_ring_close(&ring);
+}
+
+// Border pixels the filter must not read: it replicates edges by itself
+static void fill_border(Image* img, uint8_t value) {
+    for (int y = -img->border; y < img->height + img->border; ++y) {
+        uint8_t* row = image_row(img, y);
+        memset(row - img->border, value, (size_t)img->border);
+        memset(row + img->width, value, (size_t)img->border);
+    }
+}
+
+// Replicated-border window sum, pixel by pixel
+static int box_window_sum(const Image* src, int x, int y, int ksize) {
+    int r = ksize / 2;
+    int sum = 0;
+    for (int dy = -r; dy <= r; ++dy) {
+        int sy = y + dy < 0 ? 0 : (y + dy >= src->height ? src->height - 1 : y + dy);
+        const uint8_t* row = image_row(src, sy);
+        for (int dx = -r; dx <= r; ++dx) {
+            int sx = x + dx < 0 ? 0 : (x + dx >= src->width ? src->width - 1 : x + dx);
+            sum += row[sx];
+        }
+    }
+    return sum;
+}
+
+static void check_box_pixel(const Image* src, const Image* dst, int x, int y, int ksize) {
+    int area = ksize * ksize;
+    int expected = (box_window_sum(src, x, y, ksize) + area / 2) / area;
+    check(image_row(dst, y)[x] == expected, "box filter is the rounded mean");
+}
+
+// Every supported kernel size against a brute-force rounded mean, on strided
+// images with a poisoned border. Random and saturated images cover the edges
+// and the largest sums; the band image puts two neighbouring windows of every
+// band right below and above a rounding boundary, (q + 1/2) * area +- 1/2 for
+// every q, where an inexact reciprocal goes wrong first.
+void test_box_filter() {
+    printf("Running test_box_filter...\n");
+    const int w = 19, h = 13;
+    Image src = image_create_padded(w, h, 7);
+    Image dst = image_create_padded(w, h, 3);
+    BoxFilterScratch scratch = { NULL, 0 };
+    check(src.stride > w && dst.stride > w, "strided images");
+    srand(7);
+    for (int pass = 0; pass < 2; ++pass) {
+        for (int y = 0; y < h; ++y)
+            for (int x = 0; x < w; ++x)
+                image_row(&src, y)[x] = pass ? 255 : (uint8_t)(rand() & 0xFF);
+        fill_border(&src, pass ? 0 : 255);
+        for (int ksize = 1; ksize <= BOX_MAX_KSIZE; ksize += 2) {
+            box_filter(&src, &dst, ksize, NULL, &scratch);
+            for (int y = 0; y < h; ++y)
+                for (int x = 0; x < w; ++x)
+                    check_box_pixel(&src, &dst, x, y, ksize);
+            check(dst.border == 3, "dst keeps its border");
+        }
+    }
+    image_free(&dst);
+    image_free(&src);
+
+    // Band q is ksize + 1 columns of q with (area - 1) / 2 pixels of q + 1
+    // inside its first window and one more in its last column
+    for (int ksize = 1; ksize <= BOX_MAX_KSIZE; ksize += 2) {
+        int bands = 255, band_w = ksize + 1, r = ksize / 2;
+        int extra = (ksize * ksize - 1) / 2;
+        Image band_src = image_create_padded(bands * band_w, ksize, 5);
+        Image band_dst = image_create_padded(bands * band_w, ksize, 2);
+        fill_border(&band_src, 255);
+        for (int q = 0; q < bands; ++q) {
+            int x0 = q * band_w;
+            for (int y = 0; y < ksize; ++y)
+                memset(image_row(&band_src, y) + x0, q, (size_t)band_w);
+            for (int i = 0; i < extra; ++i)
+                image_row(&band_src, i % ksize)[x0 + 1 + i / ksize] = (uint8_t)(q + 1);
+            image_row(&band_src, 0)[x0 + ksize] = (uint8_t)(q + 1);
+        }
+        box_filter(&band_src, &band_dst, ksize, NULL, &scratch);
+        for (int q = 0; q < bands; ++q) {
+            check_box_pixel(&band_src, &band_dst, q * band_w + r, r, ksize);
+            check_box_pixel(&band_src, &band_dst, q * band_w + r + 1, r, ksize);
+        }
+        image_free(&band_dst);
+        image_free(&band_src);
+    }
+    box_filter_scratch_free(&scratch);
+}
+
+// Smooth texture, so that a sub-pixel shift is well defined
+static void lk_test_texture(Image* img, float shift_x, float shift_y) {
+    for (int y = 0; y < img->height; ++y)
+        for (int x = 0; x < img->width; ++x) {
+            float u = x - shift_x, v = y - shift_y;
+            float value = 128.f + 50.f * sinf(0.21f * u + 0.13f * v) + 40.f * cosf(0.17f * u - 0.23f * v) +
+                          20.f * sinf(0.05f * u * 0.7f + 0.31f * v);
+            image_row(img, y)[x] = (uint8_t)lrintf(value);
+        }
+    image_replicate_border(img);
+}
+
+// A known sub-pixel shift of a texture, tracked over the pyramid with and
+// without SSE2: both paths must agree exactly and recover the shift
+void test_pyr_lk() {
+    printf("Running test_pyr_lk...\n");
+    const int w = 160, h = 120;
+    const float shift_x = 3.4f, shift_y = -1.7f;
+    Image prev = image_create_padded(w, h, 16);
+    Image next = image_create_padded(w, h, 16);
+    lk_test_texture(&prev, 0.f, 0.f);
+    lk_test_texture(&next, shift_x, shift_y);
+    ImagePyramid prev_pyr, next_pyr;
+    image_pyramid_init(&prev_pyr);
+    image_pyramid_init(&next_pyr);
+    image_pyramid_build(&prev_pyr, &prev, 2);
+    image_pyramid_build(&next_pyr, &next, 2);
+
+    enum { POINTS = 35 };
+    Point2f points[POINTS], tracked[2][POINTS];
+    uint8_t status[2][POINTS];
+    float err[2][POINTS];
+    for (int i = 0; i < POINTS; ++i) {
+        points[i].x = 40.f + 13.3f * (i % 7);
+        points[i].y = 35.f + 12.7f * (i / 7);
+    }
+    LkParams pars = { 15, 2, 30, 0.01f, 1e-4f };
+    for (int simd = 0; simd < 2; ++simd) {
+        pyr_lk_set_simd(simd);
+        pyr_lk_track(&prev_pyr, &next_pyr, points, tracked[simd], POINTS, status[simd], err[simd], pars);
+    }
+    pyr_lk_set_simd(1);
+    for (int i = 0; i < POINTS; ++i) {
+        check(status[0][i] && status[1][i], "point tracked");
+        check(tracked[0][i].x == tracked[1][i].x && tracked[0][i].y == tracked[1][i].y &&
+              err[0][i] == err[1][i], "SSE2 and scalar agree");
+        check(fabsf(tracked[0][i].x - points[i].x - shift_x) < 0.05f &&
+              fabsf(tracked[0][i].y - points[i].y - shift_y) < 0.05f, "shift recovered");
+    }
+    image_pyramid_free(&next_pyr);
+    image_pyramid_free(&prev_pyr);
+    image_free(&next);
+    image_free(&prev);
+}
+
+static int compare_float(const void* a, const void* b) {
+    float fa = *(const float*)a, fb = *(const float*)b;
+    return (fa > fb) - (fa < fb);
+}
+
+// Every k of arrays with duplicates, all-equal values and the smallest counts
+void test_select_kth() {
+    printf("Running test_select_kth...\n");
+    float values[64], sorted[64], work[64];
+    srand(11);
+    for (int round = 0; round < 400; ++round) {
+        size_t count = round < 4 ? (size_t)(round % 2 + 1) : 1 + (size_t)(rand() % 64);
+        int distinct = round % 3 == 0 ? 1 : (round % 3 == 1 ? 3 : 1000);
+        for (size_t i = 0; i < count; ++i)
+            values[i] = (float)(rand() % distinct) * 0.5f;
+        memcpy(sorted, values, sizeof(float) * count);
+        qsort(sorted, count, sizeof(float), compare_float);
+        for (size_t k = 0; k < count; ++k) {
+            memcpy(work, values, sizeof(float) * count);
+            check(select_kth(work, count, k) == sorted[k], "select_kth matches qsort");
+        }
+    }
+}
+
+// Median of the squared distance ratios over the pairs (i, i + 1..span mod count)
+static double median_scale_reference(const Point2f* start, const Point2f* stop, size_t count, size_t span) {
+    float ratios[64 * 63];
+    size_t n = 0;
+    for (size_t i = 0; i < count; ++i)
+        for (size_t k = 1; k <= span; ++k) {
+            size_t j = span == count - 1 ? i + k : (i + k) % count;
+            if (j >= count)
+                break;
+            float pdx = start[i].x - start[j].x, pdy = start[i].y - start[j].y;
+            float cdx = stop[i].x - stop[j].x, cdy = stop[i].y - stop[j].y;
+            float prev2 = pdx * pdx + pdy * pdy;
+            if (prev2 > 1e-16f)
+                ratios[n++] = (cdx * cdx + cdy * cdy) / prev2;
+        }
+    qsort(ratios, n, sizeof(float), compare_float);
+    return sqrt((double)ratios[n / 2]);
+}
+
+// Subsampled pairs below the span cap, all pairs at and above it
+void test_median_scale() {
+    printf("Running test_median_scale...\n");
+    Point2f start[64], stop[64];
+    MedianFlowScratch scratch = { NULL, 0, 0 };
+    srand(13);
+    for (size_t count = 2; count <= 64; ++count) {
+        for (size_t i = 0; i < count; ++i) {
+            start[i].x = (float)(rand() % 200);
+            start[i].y = (float)(rand() % 200);
+            stop[i].x = 1.2f * start[i].x + (float)(rand() % 7) - 3.f;
+            stop[i].y = 1.2f * start[i].y + (float)(rand() % 7) - 3.f;
+        }
+        size_t all_pairs = count * (count - 1) / 2;
+        scratch.max_pairs = 0;
+        double all = get_median_scale(start, stop, count, &scratch);
+        check(all == median_scale_reference(start, stop, count, count - 1), "median scale over all pairs");
+        for (size_t max_pairs = 1; max_pairs < all_pairs; ++max_pairs) {
+            size_t span = (max_pairs + count - 1) / count;
+            scratch.max_pairs = max_pairs;
+            double scale = get_median_scale(start, stop, count, &scratch);
+            if (span <= (count - 1) / 2)
+                check(scale == median_scale_reference(start, stop, count, span), "subsampled median scale");
+            else
+                check(scale == all, "all pairs past the span cap");
+        }
+    }
+    median_flow_scratch_free(&scratch);
+}
+
+// A target smaller than one pyramid level, with and without a negative level
+// limit: the tracker must stay on the base level, never below it
+void test_opt_flow_small_target() {
+    printf("Running test_opt_flow_small_target...\n");
+    Image frames[2];
+    for (int f = 0; f < 2; ++f) {
+        frames[f] = image_create_padded(80, 60, 16);
+        lk_test_texture(&frames[f], 0.6f * f, 0.3f * f);
+    }
+    Rect2d target = { 30.0, 20.0, 6.0, 6.0 };
+    for (int limit = -3; limit <= 3; limit += 3) {
+        OptFlowTracker tracker;
+        opt_flow_tracker_init(&tracker);
+        opt_flow_tracker_set_limits(&tracker, 64, limit, 10);
+        check(tracker.max_level_ceiling >= 0, "level ceiling not negative");
+        opt_flow_tracker_set_frame(&tracker, &frames[0]);
+        opt_flow_tracker_set_target(&tracker, target);
+        opt_flow_tracker_set_frame(&tracker, &frames[1]);
+        opt_flow_tracker_track(&tracker);
+        check(tracker.lk_pars.max_level == 0, "small target tracked on the base level");
+        check(tracker.cur_pyr.levels_count >= 1, "pyramid has a base level");
+        opt_flow_tracker_free(&tracker);
+    }
+    image_free(&frames[1]);
+    image_free(&frames[0]);
+}
+
+#define SPSC_TEST_ITEMS 1000000
+
+// Alternates the blocking push with try_push, so both meet a full queue
+static void* spsc_test_producer(void* arg) {
+    SpscQueue* queue = (SpscQueue*)arg;
+    for (uintptr_t i = 0; i < SPSC_TEST_ITEMS; ++i) {
+        if (i & 1) {
+            spsc_queue_push(queue, (void*)i);
+        } else {
+            while (!spsc_queue_try_push(queue, (void*)i))
+                sched_yield();
+        }
+    }
+    return NULL;
+}
+
+// Single-thread edge cases, then sequence numbers streamed through a small
+// queue: the consumer must see each of them once, in order
+void test_spsc_queue() {
+    printf("Running test_spsc_queue...\n");
+    SpscQueue queue;
+    void* item = NULL;
+    check(spsc_queue_init(&queue, 0) && spsc_queue_capacity(&queue) == 2, "capacity at least 2");
+    spsc_queue_free(&queue);
+    check(spsc_queue_init(&queue, 5) && spsc_queue_capacity(&queue) == 8, "capacity rounded up");
+    spsc_queue_free(&queue);
+
+    check(spsc_queue_init(&queue, 4), "queue created");
+    check(!spsc_queue_try_pop(&queue, &item), "new queue empty");
+    for (uintptr_t round = 0; round < 3; ++round) {
+        // Several rounds, so the indices wrap around the slots
+        for (uintptr_t i = 0; i < 4; ++i)
+            check(spsc_queue_try_push(&queue, i ? (void*)(round * 4 + i) : NULL), "push below capacity");
+        check(!spsc_queue_try_push(&queue, (void*)1), "full queue refuses a push");
+        for (uintptr_t i = 0; i < 4; ++i) {
+            check(spsc_queue_try_pop(&queue, &item), "pop from a non-empty queue");
+            check(item == (i ? (void*)(round * 4 + i) : NULL), "items come out in order, NULL included");
+        }
+        check(!spsc_queue_try_pop(&queue, &item), "drained queue empty");
+    }
+    spsc_queue_free(&queue);
+
+    check(spsc_queue_init(&queue, 4), "queue created");
+    pthread_t producer;
+    pthread_create(&producer, NULL, spsc_test_producer, &queue);
+    for (uintptr_t expected = 0; expected < SPSC_TEST_ITEMS; ++expected) {
+        if (expected & 2) {
+            item = spsc_queue_pop(&queue);
+        } else {
+            while (!spsc_queue_try_pop(&queue, &item))
+                sched_yield();
+        }
+        check((uintptr_t)item == expected, "no gap or duplicate");
+    }
+    pthread_join(producer, NULL);
+    check(!spsc_queue_try_pop(&queue, &item), "nothing left over");
+    spsc_queue_free(&queue);
+}
+
 void run_tests(void) {
     test_image_crop();
     test_image_rotation();
@@ -50,5 +434,12 @@ void run_tests(void) {
     test_cmdline_parser();
     test_fern();
     test_fern_fext();
+    test_shm_frame_ring();
+    test_spsc_queue();
+    test_box_filter();
+    test_pyr_lk();
+    test_opt_flow_small_target();
+    test_select_kth();
+    test_median_scale();
 }
 